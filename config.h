@@ -5,7 +5,25 @@
 #define SELECTION_TEXT   "selection"
 
 #define SHOW_HIDDEN FALSE
+#define SORT_ORDER  SORT_NAME // or SORT_SIZE, SORT_MTIME, SORT_EXT, SORT_NATURAL
 #define EXPAND_HOME TRUE
+#define PREVIEW     FALSE // show the file under the cursor next to the listing
+#define PREVIEW_WIDTH 40  // percent of the screen the preview takes
+#define COLUMNS     FALSE // show the parent directory left of the listing and a preview right of it
+#define PARENT_WIDTH  20  // percent of the screen the parent directory takes
+#define PREVIEW_BYTES (16 << 10) // read of a file for its preview at most
+#define SHOW_SYSCALLS FALSE // show stat calls of the last listing in the status bar
+#define STAT_THREADS  4     // workers stat'ing big directories, 0 to stat serially
+#define LAZY_STAT     TRUE  // list names first and stat what's on screen, the rest when idle
+#define CACHE_SIZE    (64 << 20) // bytes of listings kept for directories no tab shows
+#define COPY_THREADS  4     // workers copying files, 0 to copy on the job's own thread
+#define DELETE_THREADS 4    // workers deleting directory trees, at least the job's own thread
+#define FIND_THREADS  4     // workers walking the tree of a search, at least the search's own thread
+#define FIND_DEPTH    0     // levels below the tab a search goes down, 0 for no limit
+#define DU_THREADS    4     // workers summing up directory sizes, at least the sum's own thread
+#define JUMP_AGE      10000 // visits the jump index adds up to before older ones fade
+#define JOB_SLOTS     2     // file operations running at once, the others wait their turn
+#define MOVE_REPLACE  FALSE // let moves replace existing files like mv -f
 
 #define COLOR_STATUS COLOR_RED
 #define COLOR_DIR    COLOR_CYAN
@@ -28,6 +46,10 @@
 #define KEY_SELECT_EMPTY  'u'
 
 #define KEY_SHOW_HIDDEN CTRL('h'): case '.'
+#define KEY_CYCLE_SORT  'S'
+#define KEY_DISK_USAGE  'D'
+#define KEY_PREVIEW     'P'
+#define KEY_COLUMNS     'M'
 #define KEY_NEW_TAB     CTRL('t'): case 't'
 #define KEY_NEXT_TAB    CTRL('w'): case 'w'
 
@@ -38,8 +60,16 @@
 #define KEY_MODE_COPY   'c'
 #define KEY_MODE_FIND   CTRL('f'): case '/'
 #define KEY_FIND_NEXT   CTRL('n'): case 'n'
+#define KEY_MODE_FILTER 'f'
+#define KEY_MODE_FUZZY  'F'
+#define KEY_MODE_SEARCH '?'
+#define KEY_MODE_JUMP   'z'
 #define KEY_EDIT_FILE   'e'
 #define KEY_MODE_TABS   CTRL('b')
+#define KEY_CANCEL_JOBS CTRL('x')
+#define KEY_MODE_JOBS   'J'
+#define KEY_JOB_PAUSE   'p'
+#define KEY_JOB_CANCEL  'x': case 'd'
 
 #define KEY_NAVUP   'k'
 #define KEY_NAVDOWN 'j'
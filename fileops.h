@@ -0,0 +1,490 @@
+#ifndef __FILEOPS_H
+#define __FILEOPS_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+#include "walk.h"
+
+// file operations running on their own threads. a copy has a coordinator
+// walking the sources, creating directories and links itself, and handing
+// regular files to a few workers copying them. a delete spreads the
+// directories over workers stealing from each other, each directory being
+// removed by whoever finishes its last child. a move renames what it can
+// and copies and deletes what lives on another filesystem.
+enum { OP_COPY, OP_MOVE, OP_DELETE, NUM_OPS };
+
+struct fileop_task {
+    char *src, *dst;
+};
+
+struct fileop {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    void (*notify)(void); // called from the op's threads when it's done
+    char **srcs, *dst;
+    struct fileop_task *tasks;
+    size_t num_srcs, num_tasks, tasks_cap, next_task;
+    size_t bytes, total, files, errors; // total: bytes to copy found so far
+    struct timespec start, paused_at;
+    double paused_for;
+    int kind, threads, cancel, paused, started, scanning, done;
+    int replace; // moves may replace existing files
+};
+
+// an op doing nothing until it's started. a copy or move goes into dst
+// like cp -rf and mv -f, a delete takes no dst. srcs are absolute paths.
+struct fileop *fileop_new(int kind, char **srcs, size_t num_srcs, const char *dst, int threads, void (*notify)(void));
+void fileop_start(struct fileop *op);
+void fileop_cancel(struct fileop *op);
+void fileop_pause(struct fileop *op, int paused);
+int fileop_done(struct fileop *op);
+double fileop_elapsed(struct fileop *op); // not counting pauses
+void fileop_free(struct fileop *op); // only once it's done or if it never started
+
+#ifdef FILEOPS_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <stdio.h>
+
+#define FILEOP_CHUNK (8 << 20)
+#define FILEOP_DENTS (1 << 16)
+
+// blocks while the op is paused
+static inline int _fileop_canceled(struct fileop *op) {
+    pthread_mutex_lock(&op->lock);
+    while (op->paused && !op->cancel) pthread_cond_wait(&op->cond, &op->lock);
+    const int cancel = op->cancel;
+    pthread_mutex_unlock(&op->lock);
+    return cancel;
+}
+
+static void _fileop_error(struct fileop *op) {
+    pthread_mutex_lock(&op->lock);
+    ++op->errors;
+    pthread_mutex_unlock(&op->lock);
+}
+
+static void _fileop_progress(struct fileop *op, size_t bytes, size_t files) {
+    pthread_mutex_lock(&op->lock);
+    op->bytes += bytes;
+    op->files += files;
+    pthread_mutex_unlock(&op->lock);
+}
+
+static char *_fileop_join(const char *dir, const char *name) {
+    const size_t dir_sz = strlen(dir), name_sz = strlen(name);
+    char *path = malloc(dir_sz+name_sz+2);
+    memcpy(path, dir, dir_sz);
+    path[dir_sz] = '/';
+    memcpy(path+dir_sz+1, name, name_sz+1);
+    return path;
+}
+
+// moves the data over, cheapest way first: share the extents if the
+// filesystem can, then in-kernel copies, then plain read and write.
+static int _copy_data(struct fileop *op, int in, int out) {
+    char buf[1 << 16];
+    ssize_t n;
+    if (!ioctl(out, FICLONE, in)) {
+        struct stat st;
+        if (!fstat(in, &st)) _fileop_progress(op, st.st_size, 0);
+        return 0;
+    }
+    int use_cfr = 1, use_sendfile = 1;
+    for (;;) {
+        if (_fileop_canceled(op)) return -1;
+        if (use_cfr) {
+            n = copy_file_range(in, NULL, out, NULL, FILEOP_CHUNK, 0);
+            if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+                use_cfr = 0;
+                continue;
+            }
+        } else if (use_sendfile) {
+            n = sendfile(out, in, NULL, FILEOP_CHUNK);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                use_sendfile = 0;
+                continue;
+            }
+        } else {
+            n = read(in, buf, sizeof(buf));
+            for (ssize_t w, off = 0; n > 0 && off < n; off += w)
+                if ((w = write(out, buf+off, n-off)) < 0) return -1;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n;
+        _fileop_progress(op, n, 0);
+    }
+}
+
+static void _copy_file(struct fileop *op, struct fileop_task *task) {
+    struct stat src_st, dst_st;
+    int in = open(task->src, O_RDONLY|O_CLOEXEC), out = -1;
+    if (in < 0 || fstat(in, &src_st)) goto fail;
+    // copying a file onto itself would truncate it
+    if (!stat(task->dst, &dst_st) && dst_st.st_dev == src_st.st_dev && dst_st.st_ino == src_st.st_ino) goto fail;
+    out = open(task->dst, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, src_st.st_mode & 07777);
+    if (out < 0 && errno == EACCES && !unlink(task->dst))
+        out = open(task->dst, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, src_st.st_mode & 07777);
+    if (out < 0 || _copy_data(op, in, out)) goto fail;
+    close(in);
+    close(out);
+    _fileop_progress(op, 0, 1);
+    return;
+fail:
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    _fileop_error(op);
+}
+
+static void _push_task(struct fileop *op, char *src, char *dst) {
+    pthread_mutex_lock(&op->lock);
+    if (op->num_tasks >= op->tasks_cap)
+        op->tasks = realloc(op->tasks, (op->tasks_cap = op->tasks_cap? op->tasks_cap*2 : 64)*sizeof(struct fileop_task));
+    op->tasks[op->num_tasks++] = (struct fileop_task){ src, dst };
+    pthread_cond_signal(&op->cond);
+    pthread_mutex_unlock(&op->lock);
+}
+
+static void *_fileop_worker(void *arg) {
+    struct fileop *op = arg;
+    pthread_mutex_lock(&op->lock);
+    for (;;) {
+        while (!op->cancel && op->scanning && op->next_task >= op->num_tasks)
+            pthread_cond_wait(&op->cond, &op->lock);
+        if (op->cancel || op->next_task >= op->num_tasks) break;
+        struct fileop_task task = op->tasks[op->next_task++];
+        pthread_mutex_unlock(&op->lock);
+        _copy_file(op, &task);
+        free(task.src);
+        free(task.dst);
+        pthread_mutex_lock(&op->lock);
+    }
+    pthread_mutex_unlock(&op->lock);
+    return NULL;
+}
+
+// src and dst are taken over, directories are created before anything
+// is queued in them.
+static void _copy_tree(struct fileop *op, char *src, char *dst) {
+    struct stat st;
+    if (_fileop_canceled(op) || lstat(src, &st)) goto fail;
+    if (S_ISREG(st.st_mode)) {
+        pthread_mutex_lock(&op->lock);
+        op->total += st.st_size;
+        pthread_mutex_unlock(&op->lock);
+        return _push_task(op, src, dst);
+    }
+    if (S_ISLNK(st.st_mode)) {
+        char target[PATH_MAX];
+        const ssize_t sz = readlink(src, target, sizeof(target)-1);
+        if (sz < 0) goto fail;
+        target[sz] = 0;
+        unlink(dst);
+        if (symlink(target, dst)) goto fail;
+    } else if (S_ISDIR(st.st_mode)) {
+        const size_t src_sz = strlen(src);
+        // never copy a directory into itself
+        if (!strncmp(dst, src, src_sz) && dst[src_sz] == '/') goto fail;
+        if (mkdir(dst, (st.st_mode & 07777) | S_IRWXU) && errno != EEXIST) goto fail;
+        DIR *dir = opendir(src);
+        struct dirent *ent;
+        if (!dir) goto fail;
+        while ((ent = readdir(dir)) != NULL) {
+            if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
+            _copy_tree(op, _fileop_join(src, ent->d_name), _fileop_join(dst, ent->d_name));
+        }
+        closedir(dir);
+    } else goto fail;
+    free(src);
+    free(dst);
+    return;
+fail:
+    _fileop_error(op);
+    free(src);
+    free(dst);
+}
+
+// a directory being deleted. pending counts its children still around plus
+// one while it's being listed, its fd stays open until it drops to 0 so the
+// children can be opened and removed relative to it.
+struct rm_dir {
+    struct rm_dir *parent;
+    int fd, pending;
+    char name[];
+};
+
+// one of the workers of a delete, walking with the others
+struct rm_worker {
+    struct fileop *op;
+    struct walk *walk;
+    int id;
+};
+
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static struct rm_dir *_rm_dir(struct rm_dir *parent, const char *name) {
+    const size_t sz = strlen(name)+1;
+    struct rm_dir *dir = malloc(sizeof(struct rm_dir)+sz);
+    dir->parent = parent;
+    dir->fd = -1;
+    dir->pending = 1;
+    memcpy(dir->name, name, sz);
+    if (parent) __atomic_add_fetch(&parent->pending, 1, __ATOMIC_RELAXED);
+    return dir;
+}
+
+// drops a reference on dir, the last one removes it and goes on up
+static void _rm_release(struct fileop *op, struct rm_dir *dir) {
+    while (dir && !__atomic_sub_fetch(&dir->pending, 1, __ATOMIC_ACQ_REL)) {
+        struct rm_dir *parent = dir->parent;
+        if (dir->fd >= 0) close(dir->fd);
+        if (!_fileop_canceled(op)) {
+            if (unlinkat(parent? parent->fd : AT_FDCWD, dir->name, AT_REMOVEDIR)) _fileop_error(op);
+            else _fileop_progress(op, 0, 1);
+        }
+        free(dir);
+        dir = parent;
+    }
+}
+
+static void _rm_list(struct rm_worker *w, struct rm_dir *dir, char *buf) {
+    struct fileop *op = w->op;
+    long n;
+    if (_fileop_canceled(op)) return;
+    dir->fd = openat(dir->parent? dir->parent->fd : AT_FDCWD, dir->name, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+    if (dir->fd < 0) return _fileop_error(op);
+    while ((n = syscall(SYS_getdents64, dir->fd, buf, FILEOP_DENTS)) > 0) {
+        size_t removed = 0;
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64 *ent = (void*)(buf+off);
+            off += ent->d_reclen;
+            const char *name = ent->d_name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+            int is_dir = (ent->d_type == DT_DIR);
+            if (ent->d_type == DT_UNKNOWN) {
+                struct stat st;
+                is_dir = !fstatat(dir->fd, name, &st, AT_SYMLINK_NOFOLLOW) && S_ISDIR(st.st_mode);
+            }
+            if (is_dir) walk_push(w->walk, w->id, _rm_dir(dir, name));
+            else if (unlinkat(dir->fd, name, 0)) _fileop_error(op);
+            else ++removed;
+        }
+        _fileop_progress(op, 0, removed);
+        if (_fileop_canceled(op)) break;
+    }
+    if (n < 0) _fileop_error(op);
+}
+
+static void *_rm_worker(void *arg) {
+    struct rm_worker *w = arg;
+    char *buf = malloc(FILEOP_DENTS);
+    struct rm_dir *dir;
+    for (;;) {
+        if ((dir = walk_take(w->walk, w->id)) != NULL) {
+            _rm_list(w, dir, buf);
+            _rm_release(w->op, dir);
+            walk_done(w->walk);
+            continue;
+        }
+        if (walk_wait(w->walk)) break;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void _delete_all(struct fileop *op, char **srcs, size_t num_srcs) {
+    struct walk walk;
+    walk_init(&walk, op->threads);
+    struct rm_worker workers[walk.num];
+    for (int i = 0; i < walk.num; ++i) workers[i] = (struct rm_worker){ op, &walk, i };
+    for (size_t i = 0; i < num_srcs; ++i) {
+        struct stat st;
+        if (lstat(srcs[i], &st)) _fileop_error(op);
+        else if (S_ISDIR(st.st_mode)) walk_push(&walk, 0, _rm_dir(NULL, srcs[i]));
+        else if (unlink(srcs[i])) _fileop_error(op);
+        else _fileop_progress(op, 0, 1);
+    }
+    walk_run(&walk, _rm_worker, workers, sizeof(struct rm_worker));
+    walk_free(&walk);
+}
+
+// where src goes, dst is a directory to put it in or the new name
+static char *_fileop_target(const char *src, const char *dst, int to_dir) {
+    const char *base = strrchr(src, '/');
+    return to_dir? _fileop_join(dst, base? base+1 : src) : strdup(dst);
+}
+
+static int _fileop_to_dir(const char *dst) {
+    struct stat st;
+    return !stat(dst, &st) && S_ISDIR(st.st_mode);
+}
+
+static void _copy_all(struct fileop *op, char **srcs, size_t num_srcs) {
+    pthread_t workers[op->threads? op->threads : 1];
+    int num_workers = 0;
+    const int to_dir = _fileop_to_dir(op->dst);
+    for (; num_workers < op->threads; ++num_workers)
+        if (pthread_create(&workers[num_workers], NULL, _fileop_worker, op)) break;
+    for (size_t i = 0; i < num_srcs; ++i)
+        _copy_tree(op, strdup(srcs[i]), _fileop_target(srcs[i], op->dst, to_dir));
+    pthread_mutex_lock(&op->lock);
+    op->scanning = 0;
+    pthread_cond_broadcast(&op->cond);
+    pthread_mutex_unlock(&op->lock);
+    // no worker to spare, copy everything from here
+    if (!num_workers) _fileop_worker(op);
+    for (int i = 0; i < num_workers; ++i) pthread_join(workers[i], NULL);
+}
+
+// renames everything it can, the target is never replaced unless asked
+// to. whatever lives on another filesystem is copied over and its source
+// only deleted once the whole copy went fine.
+static void _move_all(struct fileop *op) {
+    char **exdev = malloc(op->num_srcs*sizeof(char*));
+    size_t num_exdev = 0;
+    const int to_dir = _fileop_to_dir(op->dst);
+    const int dst_fd = to_dir? open(op->dst, O_RDONLY|O_DIRECTORY|O_CLOEXEC) : AT_FDCWD;
+    const unsigned flags = op->replace? 0 : RENAME_NOREPLACE;
+    for (size_t i = 0; i < op->num_srcs && !_fileop_canceled(op); ++i) {
+        char *src = op->srcs[i], *base = strrchr(src, '/');
+        const char *name = to_dir? (base? base+1 : src) : op->dst;
+        int ret = renameat2(AT_FDCWD, src, dst_fd, name, flags);
+        if (ret && errno == EINVAL && flags) {
+            // the filesystem can't do it, check by hand
+            struct stat st;
+            if (!fstatat(dst_fd, name, &st, AT_SYMLINK_NOFOLLOW)) errno = EEXIST;
+            else ret = renameat(AT_FDCWD, src, dst_fd, name);
+        }
+        if (!ret) _fileop_progress(op, 0, 1);
+        else if (errno == EXDEV) {
+            struct stat st;
+            if (!op->replace && !fstatat(dst_fd, name, &st, AT_SYMLINK_NOFOLLOW)) _fileop_error(op);
+            else exdev[num_exdev++] = src;
+        } else _fileop_error(op);
+    }
+    if (dst_fd >= 0 && dst_fd != AT_FDCWD) close(dst_fd);
+    if (num_exdev) {
+        const size_t errors = op->errors;
+        _copy_all(op, exdev, num_exdev);
+        if (op->errors == errors && !_fileop_canceled(op)) {
+            // files counts moved entries, not what it took to delete them
+            const size_t files = op->files;
+            _delete_all(op, exdev, num_exdev);
+            pthread_mutex_lock(&op->lock);
+            op->files = files;
+            pthread_mutex_unlock(&op->lock);
+        }
+    }
+    free(exdev);
+}
+
+static void *_fileop_run(void *arg) {
+    struct fileop *op = arg;
+    if (op->kind == OP_COPY) _copy_all(op, op->srcs, op->num_srcs);
+    else if (op->kind == OP_MOVE) _move_all(op);
+    else _delete_all(op, op->srcs, op->num_srcs);
+    // op can be freed as soon as it's done, so it isn't touched after
+    void (*notify)(void) = op->notify;
+    pthread_mutex_lock(&op->lock);
+    op->done = 1;
+    pthread_mutex_unlock(&op->lock);
+    if (notify) notify();
+    return NULL;
+}
+
+struct fileop *fileop_new(int kind, char **srcs, size_t num_srcs, const char *dst, int threads, void (*notify)(void)) {
+    struct fileop *op = calloc(1, sizeof(struct fileop));
+    pthread_mutex_init(&op->lock, NULL);
+    pthread_cond_init(&op->cond, NULL);
+    op->kind = kind;
+    op->notify = notify;
+    op->threads = threads;
+    op->scanning = 1;
+    op->srcs = malloc(num_srcs*sizeof(char*));
+    for (op->num_srcs = 0; op->num_srcs < num_srcs; ++op->num_srcs)
+        op->srcs[op->num_srcs] = strdup(srcs[op->num_srcs]);
+    op->dst = dst? strdup(dst) : NULL;
+    return op;
+}
+
+void fileop_start(struct fileop *op) {
+    pthread_t thread;
+    clock_gettime(CLOCK_MONOTONIC, &op->start);
+    op->paused_at = op->start;
+    op->started = 1;
+    if (pthread_create(&thread, NULL, _fileop_run, op)) _fileop_run(op);
+    else pthread_detach(thread);
+}
+
+void fileop_cancel(struct fileop *op) {
+    pthread_mutex_lock(&op->lock);
+    op->cancel = 1;
+    pthread_cond_broadcast(&op->cond);
+    pthread_mutex_unlock(&op->lock);
+}
+
+static double _fileop_since(struct timespec *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec-t->tv_sec) + (now.tv_nsec-t->tv_nsec)/1e9;
+}
+
+void fileop_pause(struct fileop *op, int paused) {
+    pthread_mutex_lock(&op->lock);
+    if (op->paused != paused) {
+        if (paused) clock_gettime(CLOCK_MONOTONIC, &op->paused_at);
+        else op->paused_for += _fileop_since(&op->paused_at);
+    }
+    op->paused = paused;
+    pthread_cond_broadcast(&op->cond);
+    pthread_mutex_unlock(&op->lock);
+}
+
+int fileop_done(struct fileop *op) {
+    pthread_mutex_lock(&op->lock);
+    const int done = op->done;
+    pthread_mutex_unlock(&op->lock);
+    return done;
+}
+
+double fileop_elapsed(struct fileop *op) {
+    if (!op->started) return 0;
+    const double elapsed = _fileop_since(&op->start) - op->paused_for;
+    return op->paused? elapsed - _fileop_since(&op->paused_at) : elapsed;
+}
+
+void fileop_free(struct fileop *op) {
+    for (size_t i = op->next_task; i < op->num_tasks; ++i) {
+        free(op->tasks[i].src);
+        free(op->tasks[i].dst);
+    }
+    for (size_t i = 0; i < op->num_srcs; ++i) free(op->srcs[i]);
+    free(op->srcs);
+    free(op->dst);
+    free(op->tasks);
+    pthread_mutex_destroy(&op->lock);
+    pthread_cond_destroy(&op->cond);
+    free(op);
+}
+
+#endif
+
+#endif
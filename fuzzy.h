@@ -0,0 +1,149 @@
+#ifndef __FUZZY_H
+#define __FUZZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fzf style matching: the characters of the pattern have to show up in
+// order, case-insensitively, and the shortest window they do so in gets
+// scored by where they land. every string can be boiled down to a mask
+// of the characters it has, checking those against the pattern's weeds
+// out most strings without looking at them.
+#define FUZZY_MAX 64 // pattern bytes looked at
+
+struct fuzzy {
+    char pattern[FUZZY_MAX]; // folded
+    int sz;
+    uint64_t mask;
+};
+
+void fuzzy_init(struct fuzzy *fz, const char *pattern, size_t sz);
+int fuzzy_match(const struct fuzzy *fz, const char *str, size_t sz); // score, -1 if it doesn't match
+uint64_t fuzzy_mask(const char *str, size_t sz);
+// hits[i] is 0 if masks[i] has every bit of want, -1 if not
+void fuzzy_prefilter(uint64_t want, const uint64_t *masks, size_t n, int32_t *hits);
+
+#ifdef FUZZY_IMPL
+
+#include <string.h>
+// avx2 is built in whatever the flags are and picked at runtime
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__TINYC__)
+#define _FUZZY_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define FUZZY_MATCH       16
+#define FUZZY_GAP_START   3
+#define FUZZY_GAP_EXTEND  1
+#define FUZZY_BOUNDARY    8 // first byte, or right after a separator
+#define FUZZY_CAMEL       7 // lower to upper case, or into a number
+#define FUZZY_CONSECUTIVE 4
+
+#define _FUZZY_UPPER(c) ((c) >= 'A' && (c) <= 'Z')
+#define _FUZZY_LOWER(c) ((c) >= 'a' && (c) <= 'z')
+#define _FUZZY_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+// ascii only, other bytes have to match exactly
+static inline char _fuzzy_fold(char c) {
+    return _FUZZY_UPPER(c)? c|0x20 : c;
+}
+
+// letters and digits get a bit each, everything else shares the rest
+static inline int _fuzzy_bit(char c) {
+    const unsigned char u = _fuzzy_fold(c);
+    if (_FUZZY_LOWER(u)) return u-'a';
+    if (_FUZZY_DIGIT(u)) return 26+u-'0';
+    return 36+u%28;
+}
+
+uint64_t fuzzy_mask(const char *str, size_t sz) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < sz; ++i) mask |= (uint64_t)1 << _fuzzy_bit(str[i]);
+    return mask;
+}
+
+void fuzzy_init(struct fuzzy *fz, const char *pattern, size_t sz) {
+    fz->sz = sz < FUZZY_MAX? sz : FUZZY_MAX;
+    for (int i = 0; i < fz->sz; ++i) fz->pattern[i] = _fuzzy_fold(pattern[i]);
+    fz->mask = fuzzy_mask(pattern, fz->sz);
+}
+
+// each returns how many masks it went through
+#ifdef _FUZZY_AVX2
+__attribute__((target("avx2")))
+static size_t _fuzzy_prefilter_avx2(uint64_t want, const uint64_t *masks, size_t n, int32_t *hits) {
+    size_t i = 0;
+    const __m256i w = _mm256_set1_epi64x(want);
+    for (; i+4 <= n; i += 4) {
+        const __m256i m = _mm256_loadu_si256((const __m256i*)(masks+i));
+        const int eq = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(m, w), w)));
+        for (int k = 0; k < 4; ++k) hits[i+k] = (eq >> k & 1)-1;
+    }
+    return i;
+}
+#endif
+
+#ifdef __SSE2__
+static size_t _fuzzy_prefilter_sse2(uint64_t want, const uint64_t *masks, size_t n, int32_t *hits) {
+    size_t i = 0;
+    // no 64 bit compare, both halves have to be equal
+    const __m128i w = _mm_set1_epi64x(want);
+    for (; i+2 <= n; i += 2) {
+        const __m128i m = _mm_loadu_si128((const __m128i*)(masks+i));
+        const int eq = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(m, w), w)));
+        hits[i] = ((eq & 3) == 3)-1;
+        hits[i+1] = ((eq & 12) == 12)-1;
+    }
+    return i;
+}
+#endif
+
+void fuzzy_prefilter(uint64_t want, const uint64_t *masks, size_t n, int32_t *hits) {
+    size_t i = 0;
+#ifdef _FUZZY_AVX2
+    if (__builtin_cpu_supports("avx2")) i = _fuzzy_prefilter_avx2(want, masks, n, hits);
+#endif
+#ifdef __SSE2__
+    if (!i) i = _fuzzy_prefilter_sse2(want, masks, n, hits);
+#endif
+    for (; i < n; ++i) hits[i] = ((masks[i] & want) == want)-1;
+}
+
+static inline int _fuzzy_bonus(const char *str, size_t i) {
+    if (i == 0) return FUZZY_BOUNDARY;
+    const char prev = str[i-1], cur = str[i];
+    if (prev == '/' || prev == '-' || prev == '_' || prev == '.' || prev == ' ') return FUZZY_BOUNDARY;
+    if ((_FUZZY_LOWER(prev) && _FUZZY_UPPER(cur)) || (!_FUZZY_DIGIT(prev) && _FUZZY_DIGIT(cur))) return FUZZY_CAMEL;
+    return 0;
+}
+
+int fuzzy_match(const struct fuzzy *fz, const char *str, size_t sz) {
+    size_t start, end;
+    int k = 0, score = 0, gap = 0, run = 0;
+    if (!fz->sz) return 0;
+    // the first place the whole pattern is found, then back from its end
+    // to the last place it starts
+    for (end = 0; end < sz && k < fz->sz; ++end)
+        if (_fuzzy_fold(str[end]) == fz->pattern[k]) ++k;
+    if (k < fz->sz) return -1;
+    for (start = end, k = fz->sz-1; k >= 0; )
+        if (_fuzzy_fold(str[--start]) == fz->pattern[k]) --k;
+    for (size_t i = start; i < end; ++i) {
+        if (k+1 < fz->sz && _fuzzy_fold(str[i]) == fz->pattern[k+1]) {
+            int bonus = _fuzzy_bonus(str, i);
+            if (run && bonus < FUZZY_CONSECUTIVE) bonus = FUZZY_CONSECUTIVE;
+            score += FUZZY_MATCH + (k == -1? 2*bonus : bonus);
+            ++k, run = 1, gap = 0;
+        } else {
+            score -= gap? FUZZY_GAP_EXTEND : FUZZY_GAP_START;
+            gap = 1, run = 0;
+        }
+    }
+    return score > 0? score : 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef __JUMP_H
+#define __JUMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fuzzy.h"
+
+// index of the directories visited and how often and lately they were,
+// shared by every instance through a file mapped in. an open addressing
+// table up front points into the entries appended after it, so a visit
+// only touches its own slot and entry and nothing is read at startup.
+// whoever changes the file holds an exclusive flock on it. growing the
+// table or aging the ranks writes a new file renamed over the old one,
+// the others follow it the next time they lock.
+#ifndef JUMP_AGE
+#define JUMP_AGE 10000 // ranks add up to this before every one of them fades
+#endif
+
+struct jump {
+    int fd;
+    char *file;
+    void *map;
+    size_t map_sz;
+};
+
+// -1 if there's no index to use, every other call is a no-op then
+int jump_open(struct jump *j, const char *dir);
+void jump_close(struct jump *j);
+void jump_visit(struct jump *j, const char *path);
+void jump_forget(struct jump *j, const char *path);
+// the max directories matching pattern fuzzily, best first. fills items
+// with copies of their paths and returns how many, or -1 without touching
+// them while another instance is changing the index.
+int jump_query(struct jump *j, const char *pattern, size_t sz, char **items, int max);
+
+#ifdef JUMP_IMPL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define JUMP_MAGIC 0x31504d4a // "JMP1"
+#define JUMP_MIN_CAP 1024
+#define JUMP_MIN_FILE (64 << 10)
+
+struct jump_head {
+    uint32_t magic, cap, count, pad; // count: entries, forgotten ones too
+    uint64_t size; // bytes in use, the next entry goes there
+    double total; // of the ranks
+};
+
+struct jump_slot {
+    uint32_t hash, off; // off 0 is an empty slot
+};
+
+struct jump_entry {
+    uint64_t mask; // fuzzy_mask of the path
+    int64_t time; // of the last visit
+    float rank; // visits, faded with age, 0 once forgotten
+    uint16_t sz;
+    char path[];
+};
+
+#define _JUMP_HEAD(j) ((struct jump_head*)(j)->map)
+#define _JUMP_SLOTS(j) ((struct jump_slot*)((char*)(j)->map + sizeof(struct jump_head)))
+#define _JUMP_AT(j, off) ((struct jump_entry*)((char*)(j)->map + (off)))
+#define _JUMP_START(cap) (sizeof(struct jump_head) + (size_t)(cap)*sizeof(struct jump_slot))
+#define _JUMP_SIZE(sz) ((offsetof(struct jump_entry, path)+(sz)+1+7) & ~(size_t)7)
+#define _JUMP_BROKEN UINT32_MAX
+
+static inline uint32_t _jump_hash(const char *str, size_t sz) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sz; ++i) hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    return hash;
+}
+
+static int _jump_map(struct jump *j) {
+    struct stat st;
+    if (j->map) munmap(j->map, j->map_sz);
+    j->map = NULL, j->map_sz = 0;
+    if (fstat(j->fd, &st) || !st.st_size) return -1;
+    j->map = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, j->fd, 0);
+    if (j->map == MAP_FAILED) return (j->map = NULL), -1;
+    j->map_sz = st.st_size;
+    return 0;
+}
+
+static int _jump_valid(struct jump *j) {
+    const struct jump_head *h = _JUMP_HEAD(j);
+    if (!j->map || j->map_sz < sizeof(struct jump_head) || h->magic != JUMP_MAGIC) return 0;
+    if (!h->cap || h->cap & (h->cap-1) || h->size > j->map_sz || h->size < _JUMP_START(h->cap)) return 0;
+    if (h->count > (h->size-_JUMP_START(h->cap))/_JUMP_SIZE(0)) return 0;
+    return 1;
+}
+
+// whether there's a whole entry at off, nothing read from the file is
+// trusted to point at one
+static inline int _jump_fits(struct jump *j, size_t off) {
+    const struct jump_head *h = _JUMP_HEAD(j);
+    if (off < _JUMP_START(h->cap) || off & 7 || off+offsetof(struct jump_entry, path) > h->size) return 0;
+    return off+_JUMP_SIZE(_JUMP_AT(j, off)->sz) <= h->size;
+}
+
+// an empty index of len bytes with cap slots
+static int _jump_format(struct jump *j, uint32_t cap, size_t len) {
+    if (ftruncate(j->fd, 0) || ftruncate(j->fd, len) || _jump_map(j)) return -1;
+    *_JUMP_HEAD(j) = (struct jump_head){ .magic = JUMP_MAGIC, .cap = cap, .size = _JUMP_START(cap) };
+    return 0;
+}
+
+// locks the index, following it to the new file if another instance
+// replaced it and mapping whatever it grew by since. a broken index is
+// started over by the first one locking it to write.
+static int _jump_lock(struct jump *j, int op) {
+    struct stat path_st, fd_st;
+    if (j->fd < 0) return -1;
+    for (;;) {
+        if (flock(j->fd, op)) return -1;
+        if (fstat(j->fd, &fd_st)) goto fail;
+        if (stat(j->file, &path_st) || (path_st.st_dev == fd_st.st_dev && path_st.st_ino == fd_st.st_ino)) break;
+        const int fd = open(j->file, O_RDWR|O_CLOEXEC);
+        if (fd < 0) break;
+        close(j->fd);
+        j->fd = fd;
+        if (j->map) munmap(j->map, j->map_sz);
+        j->map = NULL, j->map_sz = 0;
+    }
+    // an empty file is a new index, one that can't be mapped is left alone
+    if ((size_t)fd_st.st_size != j->map_sz && _jump_map(j) && fd_st.st_size) goto fail;
+    if (_jump_valid(j)) return 0;
+    if (op & LOCK_EX && !_jump_format(j, JUMP_MIN_CAP, JUMP_MIN_FILE)) return 0;
+fail:
+    flock(j->fd, LOCK_UN);
+    return -1;
+}
+
+// the slot holding path, or the empty one it would go in. _JUMP_BROKEN
+// if one on the way points outside the entries or none is empty.
+static uint32_t _jump_find(struct jump *j, const char *path, size_t sz, uint32_t hash) {
+    const struct jump_head *h = _JUMP_HEAD(j);
+    const struct jump_slot *slots = _JUMP_SLOTS(j);
+    for (uint32_t n = 0, i = hash & (h->cap-1); n < h->cap; ++n, i = (i+1) & (h->cap-1)) {
+        if (!slots[i].off) return i;
+        if (!_jump_fits(j, slots[i].off)) return _JUMP_BROKEN;
+        const struct jump_entry *e = _JUMP_AT(j, slots[i].off);
+        if (slots[i].hash == hash && e->sz == sz && !memcmp(e->path, path, sz)) return i;
+    }
+    return _JUMP_BROKEN;
+}
+
+static int _jump_insert(struct jump *j, uint32_t i, uint32_t hash, const char *path, size_t sz, float rank, int64_t time) {
+    const size_t size = _JUMP_SIZE(sz);
+    struct jump_head *h = _JUMP_HEAD(j);
+    if (h->size+size > j->map_sz) {
+        if (ftruncate(j->fd, j->map_sz*2 > h->size+size? j->map_sz*2 : h->size+size) || _jump_map(j)) return -1;
+        h = _JUMP_HEAD(j);
+    }
+    struct jump_entry *e = _JUMP_AT(j, h->size);
+    e->mask = fuzzy_mask(path, sz);
+    e->time = time;
+    e->rank = rank;
+    e->sz = sz;
+    memcpy(e->path, path, sz);
+    e->path[sz] = 0;
+    _JUMP_SLOTS(j)[i] = (struct jump_slot){ hash, h->size };
+    h->size += size;
+    ++h->count;
+    h->total += rank;
+    return 0;
+}
+
+// writes what's left of the entries into a new file with cap slots and
+// renames it over the old one, which stays locked until then. ranks
+// adding up to more than JUMP_AGE fade, the ones dropping below a visit
+// are gone along with the forgotten ones.
+static int _jump_rebuild(struct jump *j, uint32_t cap) {
+    const struct jump_head *h = _JUMP_HEAD(j);
+    const double age = h->total > JUMP_AGE? JUMP_AGE*0.9/h->total : 1;
+    struct jump new = { .file = j->file };
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d", j->file, (int)getpid());
+    if ((new.fd = open(tmp, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0600)) < 0) return -1;
+    flock(new.fd, LOCK_EX);
+    const size_t len = _JUMP_START(cap) + h->size-_JUMP_START(h->cap);
+    if (_jump_format(&new, cap, len > JUMP_MIN_FILE? len : JUMP_MIN_FILE)) goto fail;
+    for (size_t off = _JUMP_START(h->cap); off < h->size && _jump_fits(j, off); off += _JUMP_SIZE(_JUMP_AT(j, off)->sz)) {
+        const struct jump_entry *e = _JUMP_AT(j, off);
+        const float rank = e->rank*age;
+        if (rank < 1) continue;
+        const uint32_t hash = _jump_hash(e->path, e->sz);
+        if (_jump_insert(&new, _jump_find(&new, e->path, e->sz, hash), hash, e->path, e->sz, rank, e->time)) goto fail;
+    }
+    if (rename(tmp, j->file)) goto fail;
+    munmap(j->map, j->map_sz);
+    close(j->fd);
+    *j = new;
+    return 0;
+fail:
+    if (new.map) munmap(new.map, new.map_sz);
+    close(new.fd);
+    unlink(tmp);
+    return -1;
+}
+
+int jump_open(struct jump *j, const char *dir) {
+    char path[PATH_MAX];
+    j->map = NULL, j->map_sz = 0, j->file = NULL;
+    j->fd = -1;
+    if (snprintf(path, sizeof(path), "%s/dirs", dir) >= (int)sizeof(path)) return -1;
+    // every directory on the way, like mkdir -p
+    for (char *p = strchr(path+1, '/'); p; p = strchr(p+1, '/')) {
+        *p = 0;
+        if (mkdir(path, 0700) && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    if ((j->fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0600)) < 0) return -1;
+    j->file = strdup(path);
+    return 0;
+}
+
+void jump_close(struct jump *j) {
+    if (j->map) munmap(j->map, j->map_sz);
+    if (j->fd >= 0) close(j->fd);
+    free(j->file);
+    j->map = NULL, j->file = NULL;
+    j->fd = -1;
+}
+
+// called on every directory listed, skipped while another instance
+// holds the lock rather than waiting on it
+void jump_visit(struct jump *j, const char *path) {
+    const size_t sz = strlen(path);
+    if (sz > UINT16_MAX || _jump_lock(j, LOCK_EX|LOCK_NB)) return;
+    const uint32_t hash = _jump_hash(path, sz);
+    uint32_t i = _jump_find(j, path, sz, hash);
+    // the slots can be put back together from the entries
+    if (i == _JUMP_BROKEN && (_jump_rebuild(j, _JUMP_HEAD(j)->cap) || (i = _jump_find(j, path, sz, hash)) == _JUMP_BROKEN))
+        goto out;
+    if (_JUMP_SLOTS(j)[i].off) {
+        struct jump_entry *e = _JUMP_AT(j, _JUMP_SLOTS(j)[i].off);
+        e->rank += 1;
+        e->time = time(NULL);
+        _JUMP_HEAD(j)->total += 1;
+    } else {
+        if ((_JUMP_HEAD(j)->count+1)*4 > _JUMP_HEAD(j)->cap*3) {
+            if (_jump_rebuild(j, _JUMP_HEAD(j)->cap*2)) goto out;
+            i = _jump_find(j, path, sz, hash);
+        }
+        _jump_insert(j, i, hash, path, sz, 1, time(NULL));
+    }
+    if (_JUMP_HEAD(j)->total > JUMP_AGE) _jump_rebuild(j, _JUMP_HEAD(j)->cap);
+out:
+    flock(j->fd, LOCK_UN);
+}
+
+// XXX: the entry stays in the file until it's rebuilt. skipped like a
+// visit if the index is busy, it's forgotten the next time it's jumped to.
+void jump_forget(struct jump *j, const char *path) {
+    const size_t sz = strlen(path);
+    if (sz > UINT16_MAX || _jump_lock(j, LOCK_EX|LOCK_NB)) return;
+    const uint32_t i = _jump_find(j, path, sz, _jump_hash(path, sz));
+    if (i != _JUMP_BROKEN && _JUMP_SLOTS(j)[i].off) {
+        struct jump_entry *e = _JUMP_AT(j, _JUMP_SLOTS(j)[i].off);
+        _JUMP_HEAD(j)->total -= e->rank;
+        e->rank = 0;
+    }
+    flock(j->fd, LOCK_UN);
+}
+
+// recent visits count for more, like z does it
+static inline double _jump_frecency(const struct jump_entry *e, int64_t now) {
+    const int64_t age = now - e->time;
+    if (age < 3600) return e->rank*4;
+    if (age < 86400) return e->rank*2;
+    if (age < 604800) return e->rank/2;
+    return e->rank/4;
+}
+
+struct jump_match {
+    double score;
+    uint32_t off;
+};
+
+static int _jump_compare(const void *a_ptr, const void *b_ptr) {
+    const struct jump_match *a = a_ptr, *b = b_ptr;
+    if (a->score != b->score) return a->score > b->score? -1 : 1;
+    return (a->off > b->off) - (a->off < b->off);
+}
+
+// entries are scored by their frecency times how well they match, the
+// masks weed out most of them before their paths are looked at
+int jump_query(struct jump *j, const char *pattern, size_t sz, char **items, int max) {
+    const int64_t now = time(NULL);
+    struct fuzzy fz;
+    size_t n = 0;
+    errno = 0;
+    if (_jump_lock(j, LOCK_SH|LOCK_NB)) return errno == EWOULDBLOCK? -1 : 0;
+    const struct jump_head *h = _JUMP_HEAD(j);
+    struct jump_match *matches = malloc((h->count+1)*sizeof(struct jump_match));
+    fuzzy_init(&fz, pattern, sz);
+    for (size_t off = _JUMP_START(h->cap); off < h->size && n < h->count && _jump_fits(j, off); off += _JUMP_SIZE(_JUMP_AT(j, off)->sz)) {
+        const struct jump_entry *e = _JUMP_AT(j, off);
+        if (e->rank <= 0 || (e->mask & fz.mask) != fz.mask) continue;
+        const int score = fuzzy_match(&fz, e->path, e->sz);
+        if (score < 0) continue;
+        matches[n++] = (struct jump_match){ _jump_frecency(e, now)*(score+1), off };
+    }
+    qsort(matches, n, sizeof(struct jump_match), _jump_compare);
+    if (n > (size_t)max) n = max;
+    for (size_t i = 0; i < n; ++i) items[i] = strndup(_JUMP_AT(j, matches[i].off)->path, _JUMP_AT(j, matches[i].off)->sz);
+    flock(j->fd, LOCK_UN);
+    free(matches);
+    return n;
+}
+
+#endif
+
+#endif
@@ -1,36 +1,110 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <ctype.h>
+#include <errno.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
 #include <sys/types.h>
 #include <ncurses.h>
 #include "lfm.h"
 #define INPUTBOX_IMPL
 #include "inputbox.h"
+#define FUZZY_IMPL
+#include "fuzzy.h"
 #include "picker.h"
+#define POOL_IMPL
+#include "pool.h"
+#define STRSET_IMPL
+#include "strset.h"
+#define JUMP_IMPL
+#include "jump.h"
+#define PREVIEW_IMPL
+#include "preview.h"
+#define WALK_IMPL
+#include "walk.h"
+#define FILEOPS_IMPL
+#include "fileops.h"
+#ifdef _USE_URING
+#include <linux/stat.h>
+#define URING_IMPL
+#include "uring.h"
+#endif
 
 static struct {
-    int show_hidden;
+    int show_hidden, sort;
 } opts;
 
+// total size of what's below a directory, as of its mtime
+struct du_entry {
+    dev_t dev;
+    ino_t ino; // 0 for an empty slot
+    struct timespec mtime;
+    int64_t bytes;
+};
+
 static struct {
     const char *prgname;
-    struct files_list selection;
+    struct strset selection; // full paths
+    unsigned sel_gen; // bumped on every change of the selection
     int mode, ww, wh, num_tabs, max_tabs;
     struct tab *tabs, *cur_tab;
     struct inputbox input;
     struct picker picker;
+    struct pool pool;
+    struct jump jump; // directories visited, over every instance
+    struct preview preview;
+    int show_preview, columns; // columns: the parent's listing goes left of the tab's
+    struct listing *parent, *child; // listings shown next to the tab's
+    struct {
+        pthread_rwlock_t lock; // taken by du workers
+        struct du_entry *buf;
+        size_t sz, cap;
+    } du;
+    int wake[2]; // written by background threads to wake up the ui
+    int inotify;
+    struct listing *listings; // every listing, most recently used first
+    int keep_meta; // set once a tab sorted by metadata, new listings keep it
+    struct fileop **jobs;
+    int num_jobs;
+    char msg[ALLOC_SIZE]; // shown in the status bar until the next key
+    // what's on the screen, rows are redrawn only when their hash changes
+    uint64_t *drawn;
+    struct tab *drawn_tab;
+    struct listing *drawn_ls;
+    int drawn_off, drawn_rows;
+    char drawn_status[ALLOC_SIZE];
+    uint64_t drawn_preview, drawn_parent; // what the columns next to the listing show
+    char preview_path[PATH_MAX]; // asked for last, at preview_gen of its listing
+    unsigned preview_gen;
+    char child_path[PATH_MAX]; // directory the cursor rests on, since child_since
+    struct timespec child_since;
+    int settle_ms; // left until the child column gets loaded, 0 if it isn't waiting
+    char home_src[PATH_MAX], home_path[PATH_MAX]; // last path expand_home'd for the status
 } lfm;
 
+static void _cancel_load(struct listing *ls);
+static void _cancel_lazy(struct listing *ls);
+static void _wake_ui(void);
+static void _set_listing(struct tab *tab, struct listing *ls);
+static void _refresh(struct tab *tab);
+static void _free_filter(struct tab *tab);
+
 static void _init_curses(void) {
     initscr();
     raw();
     noecho();
     curs_set(0);
     keypad(stdscr, TRUE);
+    nodelay(stdscr, TRUE);
+    idlok(stdscr, TRUE); // lets scrl() scroll the terminal
+
     define_key("\e[1~", KEY_HOME);
     define_key("\e[4~", KEY_END);
 #ifdef _USE_MTM
@@ -50,212 +124,2251 @@ static void _init_curses(void) {
 #endif
 }
 
-static void _quit_curses(void) {
-    endwin();
-    curs_set(1);
+static void _quit_curses(void) {
+    endwin();
+    curs_set(1);
+}
+
+static inline uint64_t _hash_row(const char *str, int attr) {
+    uint64_t hash = 14695981039346656037ull ^ (unsigned)attr;
+    for (; *str; ++str) hash = (hash ^ (unsigned char)*str) * 1099511628211ull;
+    return hash | 1; // 0 is a row that has to be drawn
+}
+
+// makes the next frame redraw everything
+static void _invalidate_screen(void) {
+    if (lfm.drawn_rows != lfm.wh-1) lfm.drawn = realloc(lfm.drawn, (lfm.drawn_rows = lfm.wh-1)*sizeof(uint64_t));
+    memset(lfm.drawn, 0, lfm.drawn_rows*sizeof(uint64_t));
+    lfm.drawn_tab = NULL;
+    lfm.drawn_preview = lfm.drawn_parent = 0;
+    lfm.drawn_status[0] = 0;
+}
+
+static void _init_files(struct files_list *list) {
+    list->order = malloc(sizeof(uint32_t) * (list->cap = ALLOC_SIZE));
+    list->buf = malloc(sizeof(struct file) * (list->buf_cap = ALLOC_SIZE));
+    list->names = malloc(list->names_cap = ALLOC_SIZE*16);
+    list->meta = NULL;
+    list->masks = NULL;
+    list->sort = SORT_NAME;
+    list->sz = list->buf_sz = list->names_sz = list->masks_sz = 0;
+}
+
+static inline void _init_meta(struct files_list *list) {
+    if (!list->meta) list->meta = calloc(list->buf_cap, sizeof(struct file_meta));
+}
+
+static void _free_files(struct files_list *list) {
+    free(list->order);
+    free(list->buf);
+    free(list->names);
+    free(list->meta);
+    free(list->masks);
+    list->meta = NULL;
+    list->masks = NULL;
+    list->masks_sz = 0;
+    list->sz = list->cap = list->buf_sz = list->buf_cap = list->names_sz = list->names_cap = 0;
+}
+
+static inline void _clear_files(struct files_list *list) {
+    list->sz = list->buf_sz = list->names_sz = list->masks_sz = 0;
+}
+
+// the new entry goes last in the order as well
+static void _append_file(struct files_list *list, struct file file, const char *name) {
+    const size_t name_sz = strlen(name);
+    if (list->sz >= list->cap)
+        list->order = realloc(list->order, sizeof(uint32_t) * (list->cap = MAX(list->cap*2, ALLOC_SIZE)));
+    if (list->buf_sz >= list->buf_cap) {
+        list->buf = realloc(list->buf, sizeof(struct file) * (list->buf_cap *= 2));
+        if (list->meta) list->meta = realloc(list->meta, sizeof(struct file_meta) * list->buf_cap);
+    }
+    if (list->names_sz+name_sz+1 > list->names_cap) {
+        while (list->names_sz+name_sz+1 > list->names_cap) list->names_cap *= 2;
+        list->names = realloc(list->names, list->names_cap);
+    }
+    memcpy(list->names+list->names_sz, name, name_sz+1);
+    file.name = list->names_sz;
+    file.name_sz = name_sz;
+    list->names_sz += name_sz+1;
+    list->order[list->sz++] = list->buf_sz;
+    if (list->meta) list->meta[list->buf_sz] = (struct file_meta){0};
+    list->buf[list->buf_sz++] = file;
+}
+
+// XXX: the entry and its name stay around until the list is cleared
+static void _remove_file(struct files_list *list, int idx) {
+    if (list->sz == 0 || idx >= list->sz) return;
+    --list->sz;
+    memmove(list->order+idx, list->order+idx+1, (list->sz-idx)*sizeof(uint32_t));
+}
+
+struct tab *create_tab(char *path) {
+    if (lfm.num_tabs >= lfm.max_tabs)
+        lfm.tabs = realloc(lfm.tabs, (lfm.max_tabs *= 1.5)*sizeof(struct tab));
+    struct tab *tab = &lfm.tabs[lfm.num_tabs++];
+    tab->path = tab->want = NULL;
+    tab->ls = NULL;
+    tab->filter = NULL;
+    tab->cur = tab->off = 0;
+    tab->show_hidden = opts.show_hidden;
+    tab->sort = opts.sort;
+    tab->du = FALSE;
+    list_files(tab, path);
+    return tab;
+}
+
+void close_tab(struct tab *tab) {
+    _free_filter(tab);
+    _set_listing(tab, NULL);
+    if (--lfm.num_tabs == 0) quit_lfm(tab->path);
+    if (tab->path) free(tab->path);
+    if (tab->want) free(tab->want);
+    lfm.mode = MODE_NONE;
+    for (struct tab *t = tab; t != &lfm.tabs[lfm.num_tabs]; ++t) *t = *(t+1);
+    if (lfm.cur_tab == &lfm.tabs[lfm.num_tabs]) --lfm.cur_tab;
+}
+
+static void _switch_tab(void) {
+    if (lfm.num_tabs > 1) {
+        struct tab *prev = lfm.cur_tab;
+        if (++lfm.cur_tab == &lfm.tabs[lfm.num_tabs])
+            lfm.cur_tab = &lfm.tabs[0];
+        if (prev->ls != lfm.cur_tab->ls) _cancel_load(prev->ls);
+        _refresh(lfm.cur_tab);
+    }
+}
+
+// the index lives in $XDG_STATE_HOME/lfm, lfm goes on without one if it can't
+static void _open_jump(void) {
+    const char *state = getenv("XDG_STATE_HOME"), *home = getenv("HOME");
+    char dir[PATH_MAX];
+    lfm.jump.fd = -1;
+    if (state && state[0] == '/') snprintf(dir, sizeof(dir), "%s/lfm", state);
+    else if (home) snprintf(dir, sizeof(dir), "%s/.local/state/lfm", home);
+    else return;
+    jump_open(&lfm.jump, dir);
+}
+
+void init_lfm(char *path) {
+    struct stat dir_stat;
+    // directories are opened in the background from here on, errors only make it to the status
+    if (stat(path, &dir_stat) || !S_ISDIR(dir_stat.st_mode)) {
+        fprintf(stderr, "error: path '%s' does not exist\n", path);
+        exit(1);
+    }
+    lfm.mode = MODE_NONE;
+    lfm.tabs = malloc((lfm.max_tabs = ALLOC_SIZE) * sizeof(struct tab));
+    lfm.num_tabs = 0;
+    strset_init(&lfm.selection);
+    pool_init(&lfm.pool, STAT_THREADS);
+    lfm.inotify = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    _open_jump();
+    pthread_rwlock_init(&lfm.du.lock, NULL);
+    preview_init(&lfm.preview, _wake_ui);
+    lfm.show_preview = PREVIEW;
+    lfm.columns = COLUMNS;
+    pipe(lfm.wake);
+    fcntl(lfm.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(lfm.wake[1], F_SETFL, O_NONBLOCK);
+    lfm.cur_tab = create_tab(path);
+    input_reset(&lfm.input);
+    picker_reset(&lfm.picker);
+}
+
+void quit_lfm(char *path) {
+    FILE *file = fopen("/tmp/lfmsel", "w");
+    fwrite(path, strlen(path), 1, file);
+    fclose(file);
+    _quit_curses();
+    exit(0);
+}
+
+// classify an entry relative to the directory it was read from. d_type
+// answers directories for free, regular files need their mode for the
+// exec bit and only symlinks get their target stat'ed as well. meta is
+// filled from the same calls, directories are only stat'ed for it.
+static struct file _stat_file(int dir_fd, const char *name, unsigned char type, size_t *syscalls, struct file_meta *meta) {
+    struct file file = {0};
+    struct stat file_stat;
+    mode_t mode = DTTOIF(type);
+    int ok = 0;
+    if (type == DT_DIR) {
+        file.type = T_DIR;
+        if (!meta) return file;
+        ++*syscalls;
+        ok = !fstatat(dir_fd, name, &file_stat, AT_SYMLINK_NOFOLLOW);
+    }
+    if (type == DT_REG || type == DT_UNKNOWN) {
+        ++*syscalls;
+        ok = !fstatat(dir_fd, name, &file_stat, AT_SYMLINK_NOFOLLOW);
+        mode = ok? file_stat.st_mode : 0;
+        if (S_ISLNK(mode)) type = DT_LNK;
+    }
+    if (type == DT_LNK) {
+        file.is_link = 1;
+        ++*syscalls;
+        ok = !fstatat(dir_fd, name, &file_stat, 0);
+        mode = ok? file_stat.st_mode : 0;
+    }
+    if (meta) *meta = ok? (struct file_meta){ file_stat.st_size, file_stat.st_mtime } : (struct file_meta){0};
+    if (type == DT_DIR) return file;
+    file.type = S_ISDIR(mode)? T_DIR : (S_ISREG(mode) && mode & S_IXUSR)? T_EXEC : T_FILE;
+    return file;
+}
+
+struct stat_job {
+    struct files_list *list;
+    int dir_fd;
+    size_t syscalls;
+    pthread_mutex_t lock;
+};
+
+// entries come in with the raw d_type in their type field and are
+// classified in place, every batch only touches its own slots. stat'ing
+// goes over every entry of the list, in the order they were read.
+static void _stat_batch(void *arg, size_t from, size_t to) {
+    struct stat_job *job = arg;
+    struct files_list *list = job->list;
+    size_t syscalls = 0;
+    for (size_t i = from; i < to; ++i) {
+        struct file *file = &list->buf[i];
+        struct file res = _stat_file(job->dir_fd, list->names+file->name, file->type, &syscalls, list->meta? &list->meta[i] : NULL);
+        file->is_link = res.is_link, file->type = res.type;
+    }
+    pthread_mutex_lock(&job->lock);
+    job->syscalls += syscalls;
+    pthread_mutex_unlock(&job->lock);
+}
+
+#ifdef _USE_URING
+static inline char _mode_to_type(mode_t mode) {
+    return S_ISDIR(mode)? T_DIR : (S_ISREG(mode) && mode & S_IXUSR)? T_EXEC : T_FILE;
+}
+
+static inline void _stat_sync(struct files_list *list, size_t i, int dir_fd, unsigned char type, size_t *syscalls) {
+    struct file res = _stat_file(dir_fd, list->names+list->buf[i].name, type, syscalls, list->meta? &list->meta[i] : NULL);
+    list->buf[i].is_link = res.is_link, list->buf[i].type = res.type;
+}
+
+// same classification as _stat_batch but statx requests for a whole window
+// of entries go through a single io_uring_enter. symlinks found by the
+// first round are queued again following the link. failed requests are
+// redone synchronously, if the ring itself breaks it is dropped for good
+// and whatever is left goes the synchronous way.
+static void _stat_uring(struct uring *r, struct files_list *list, int dir_fd, size_t *syscalls) {
+    struct statx *stx = malloc(r->entries*sizeof(struct statx));
+    size_t *slot = malloc(r->entries*sizeof(size_t)), *links = NULL;
+    size_t next = 0, num_links = 0, next_link = 0, links_cap = 0;
+    char *follow = malloc(r->entries), *seen = malloc(r->entries);
+    for (;;) {
+        unsigned queued = 0, reaped = 0;
+        while (queued < r->entries) {
+            size_t i;
+            char fl = 0;
+            if (next < list->buf_sz) {
+                struct file *file = &list->buf[i = next++];
+                if (r->fd < 0 || (file->type != DT_REG && file->type != DT_UNKNOWN && file->type != DT_LNK && !(file->type == DT_DIR && list->meta))) {
+                    _stat_sync(list, i, dir_fd, file->type, syscalls);
+                    continue;
+                }
+                fl = file->type == DT_LNK;
+            } else if (next_link < num_links) {
+                i = links[next_link++], fl = 1;
+                if (r->fd < 0) {
+                    _stat_sync(list, i, dir_fd, DT_LNK, syscalls);
+                    continue;
+                }
+            } else break;
+            struct io_uring_sqe *sqe = uring_get_sqe(r);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dir_fd;
+            sqe->addr = (uintptr_t)(list->names+list->buf[i].name);
+            sqe->len = list->meta? STATX_TYPE|STATX_MODE|STATX_SIZE|STATX_MTIME : STATX_TYPE|STATX_MODE;
+            sqe->off = (uintptr_t)&stx[queued];
+            sqe->statx_flags = fl? 0 : AT_SYMLINK_NOFOLLOW;
+            sqe->user_data = queued;
+            slot[queued] = i, seen[queued] = 0, follow[queued++] = fl;
+        }
+        if (!queued) break;
+        while (reaped < queued) {
+            ++*syscalls;
+            if (uring_submit_and_wait(r, queued-reaped) < 0 && errno != EINTR) break;
+            struct io_uring_cqe *cqe;
+            for (; (cqe = uring_peek_cqe(r)) != NULL; uring_cqe_seen(r), ++reaped) {
+                const size_t k = cqe->user_data, i = slot[k];
+                struct file *file = &list->buf[i];
+                seen[k] = 1;
+                if (cqe->res < 0) {
+                    _stat_sync(list, i, dir_fd, follow[k]? DT_LNK : DT_UNKNOWN, syscalls);
+                } else if (!follow[k] && S_ISLNK(stx[k].stx_mode)) {
+                    if (num_links >= links_cap)
+                        links = realloc(links, (links_cap = MAX(links_cap*2, ALLOC_SIZE))*sizeof(size_t));
+                    links[num_links++] = i;
+                } else {
+                    file->is_link = follow[k];
+                    file->type = _mode_to_type(stx[k].stx_mode);
+                    if (list->meta) list->meta[i] = (struct file_meta){ stx[k].stx_size, stx[k].stx_mtime.tv_sec };
+                }
+            }
+        }
+        if (reaped < queued) {
+            // XXX: requests still in flight point into stx, keep it around
+            uring_free(r);
+            stx = NULL;
+            for (unsigned k = 0; k < queued; ++k)
+                if (!seen[k]) _stat_sync(list, slot[k], dir_fd, follow[k]? DT_LNK : DT_UNKNOWN, syscalls);
+        }
+    }
+    free(stx);
+    free(slot);
+    free(follow);
+    free(seen);
+    free(links);
+}
+#endif
+
+// what follows the last dot, dotfiles without another dot have none
+static inline const char *_file_ext(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return (dot && dot != name)? dot+1 : "";
+}
+
+// case-insensitive with runs of digits compared by their value
+static int _natural_cmp(const char *a, const char *b) {
+    while (*a && *b) {
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b)) {
+            size_t na = 0, nb = 0;
+            while (*a == '0') ++a;
+            while (*b == '0') ++b;
+            while (isdigit((unsigned char)a[na])) ++na;
+            while (isdigit((unsigned char)b[nb])) ++nb;
+            if (na != nb) return na < nb? -1 : 1;
+            const int c = memcmp(a, b, na);
+            if (c) return c;
+            a += na, b += nb;
+            continue;
+        }
+        const int c = tolower((unsigned char)*a) - tolower((unsigned char)*b);
+        if (c) return c;
+        ++a, ++b;
+    }
+    return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
+// directories first, then the list's sort order. ties go by name, biggest
+// and newest files come first.
+static int _compare_entries(const struct files_list *list, uint32_t a, uint32_t b) {
+    const struct file *fa = &list->buf[a], *fb = &list->buf[b];
+    const char *na = list->names+fa->name, *nb = list->names+fb->name;
+    int c = 0;
+    if ((fa->type == T_DIR) != (fb->type == T_DIR)) return fa->type == T_DIR? -1 : 1;
+    switch (list->sort) {
+    case SORT_SIZE:
+        if (list->meta) c = (list->meta[a].size < list->meta[b].size) - (list->meta[a].size > list->meta[b].size);
+        break;
+    case SORT_MTIME:
+        if (list->meta) c = (list->meta[a].mtime < list->meta[b].mtime) - (list->meta[a].mtime > list->meta[b].mtime);
+        break;
+    case SORT_EXT:
+        c = strcasecmp(_file_ext(na), _file_ext(nb));
+        break;
+    case SORT_NATURAL:
+        c = _natural_cmp(na, nb);
+        break;
+    }
+    return c? c : strcasecmp(na, nb);
+}
+
+// merges the sorted runs [0, mid) and [mid, sz) of list
+static void _merge_files(struct files_list *list, size_t mid) {
+    if (mid == 0 || mid == list->sz) return;
+    uint32_t *tmp = malloc(list->sz*sizeof(uint32_t)), *order = list->order;
+    size_t a = 0, b = mid, i = 0;
+    while (a < mid && b < list->sz) {
+        if (_compare_entries(list, order[b], order[a]) < 0) tmp[i++] = order[b++];
+        else tmp[i++] = order[a++];
+    }
+    while (a < mid) tmp[i++] = order[a++];
+    while (b < list->sz) tmp[i++] = order[b++];
+    free(list->order);
+    list->order = tmp;
+    list->cap = list->sz;
+}
+
+// appends every entry of src to dst in src's order, returns the old size of dst
+static size_t _append_files(struct files_list *dst, struct files_list *src) {
+    const size_t mid = dst->sz;
+    for (size_t i = 0; i < src->sz; ++i) {
+        _append_file(dst, FILE_AT(src, i), FILE_NAME(src, i));
+        if (dst->meta && src->meta) dst->meta[dst->buf_sz-1] = src->meta[src->order[i]];
+    }
+    return mid;
+}
+
+// the bucket in the top byte, then what the sort order looks at first:
+// sizes and times inverted so the biggest go first, or the first bytes
+// of the name (or extension) case-folded. natural keys stop at the first
+// digit. most comparisons are settled by the keys alone.
+struct sort_key {
+    uint64_t key;
+    uint32_t idx;
+};
+
+#define KEY_MASK ((UINT64_C(1) << 56)-1)
+
+static inline uint64_t _sort_key(const struct files_list *list, uint32_t idx) {
+    const struct file *file = &list->buf[idx];
+    const char *name = list->names+file->name;
+    uint64_t key = (uint64_t)(file->type != T_DIR) << 56;
+    int64_t val;
+    switch (list->sort) {
+    case SORT_SIZE: case SORT_MTIME:
+        val = !list->meta? 0 : list->sort == SORT_SIZE? list->meta[idx].size : list->meta[idx].mtime;
+        return key | (KEY_MASK - (uint64_t)MIN(MAX(val, 0), (int64_t)KEY_MASK));
+    case SORT_EXT:
+        name = _file_ext(name);
+        break;
+    case SORT_NATURAL:
+        for (int i = 0; i < SORT_PREFIX && name[i]; ++i) {
+            if (isdigit((unsigned char)name[i])) return key | (uint64_t)'0' << (48-8*i);
+            key |= (uint64_t)tolower((unsigned char)name[i]) << (48-8*i);
+        }
+        return key;
+    }
+    for (int i = 0; i < SORT_PREFIX && name[i]; ++i)
+        key |= (uint64_t)tolower((unsigned char)name[i]) << (48-8*i);
+    return key;
+}
+
+// same order as _compare_entries, which settles equal keys
+static int _compare_keys(const void *a_ptr, const void *b_ptr, void *list_ptr) {
+    const struct sort_key *a = a_ptr, *b = b_ptr;
+    if (a->key != b->key) return a->key < b->key? -1 : 1;
+    return _compare_entries(list_ptr, a->idx, b->idx);
+}
+
+// msd radix sort on the key bytes from the top, skipping bytes every key
+// shares. small runs and runs the keys can't tell apart are left to
+// comparisons.
+static void _radix_sort(struct sort_key *keys, struct sort_key *tmp, size_t n, int shift, struct files_list *list) {
+    while (n > SORT_CUTOFF && shift >= 0) {
+        size_t count[256] = {0}, pos[256], sum = 0;
+        for (size_t i = 0; i < n; ++i) ++count[(keys[i].key >> shift) & 0xff];
+        if (count[(keys[0].key >> shift) & 0xff] == n) {
+            shift -= 8;
+            continue;
+        }
+        for (int b = 0; b < 256; sum += count[b++]) pos[b] = sum;
+        for (size_t i = 0; i < n; ++i) tmp[pos[(keys[i].key >> shift) & 0xff]++] = keys[i];
+        memcpy(keys, tmp, n*sizeof(struct sort_key));
+        sum = 0;
+        for (int b = 0; b < 256; sum += count[b++])
+            if (count[b] > 1) _radix_sort(keys+sum, tmp+sum, count[b], shift-8, list);
+        return;
+    }
+    if (n > SORT_CUTOFF) return qsort_r(keys, n, sizeof(struct sort_key), _compare_keys, list);
+    for (size_t i = 1; i < n; ++i) {
+        struct sort_key key = keys[i];
+        size_t j = i;
+        for (; j > 0 && _compare_keys(&key, &keys[j-1], list) < 0; --j) keys[j] = keys[j-1];
+        keys[j] = key;
+    }
+}
+
+static void _sort_files(struct files_list *list) {
+    struct sort_key *keys = malloc(list->sz*2*sizeof(struct sort_key));
+    for (size_t i = 0; i < list->sz; ++i)
+        keys[i] = (struct sort_key){ _sort_key(list, list->order[i]), list->order[i] };
+    _radix_sort(keys, keys+list->sz, list->sz, 56, list);
+    for (size_t i = 0; i < list->sz; ++i) list->order[i] = keys[i].idx;
+    free(keys);
+}
+
+static int _find_name(struct files_list *list, const char *name) {
+    for (int i = 0; i < list->sz; ++i)
+        if (!strcmp(FILE_NAME(list, i), name)) return i;
+    return -1;
+}
+
+// a directory read with getdents64 into a buffer of its own, big enough
+// for a huge directory to take few calls. entries are parsed where they
+// lie in it, a scan can stop after any of them and go on later from there.
+struct dir_reader {
+    int fd, end;
+    char *buf;
+    long pos, sz; // entries of buf not handed out yet are at [pos, sz)
+};
+
+static void _open_reader(struct dir_reader *rd, int fd) {
+    rd->fd = fd;
+    rd->end = 0;
+    rd->buf = malloc(LOAD_DENTS);
+    rd->pos = rd->sz = 0;
+}
+
+static void _close_reader(struct dir_reader *rd) {
+    close(rd->fd);
+    free(rd->buf);
+    rd->buf = NULL;
+}
+
+// the next entry, NULL once the directory is over or can't be read further
+static struct linux_dirent64 *_read_dent(struct dir_reader *rd) {
+    if (rd->pos >= rd->sz) {
+        const long n = rd->end? 0 : syscall(SYS_getdents64, rd->fd, rd->buf, LOAD_DENTS);
+        if (n <= 0) {
+            rd->end = 1;
+            return NULL;
+        }
+        rd->pos = 0, rd->sz = n;
+    }
+    struct linux_dirent64 *ent = (void*)(rd->buf+rd->pos);
+    rd->pos += ent->d_reclen;
+    return ent;
+}
+
+// the loader owns its directory and everything it read that the ui didn't
+// take yet. whoever sees the other side gone (done or canceled) frees it,
+// so a scan stuck on a dead mount never blocks the ui. it opens the
+// directory and stats with workers of its own for the same reason.
+struct loader {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // signaled once the directory is watched
+    struct dir_reader rd;
+    struct files_list out;
+    struct pool *pool; // started once a chunk is worth it
+#ifdef _USE_URING
+    struct uring ring;
+    int ring_tried;
+#endif
+    char *path;
+    size_t syscalls, errors; // errors: directories of a search that couldn't be read
+    int show_hidden, cancel, done, replace, lazy; // lazy: entries aren't stat'ed
+    int fd, err, opened, watched; // err: errno of opening the directory
+};
+
+// an empty list kept in the same order and with the same fields as like
+static void _init_like(struct files_list *list, struct files_list *like) {
+    _init_files(list);
+    list->sort = like->sort;
+    if (like->meta) _init_meta(list);
+}
+
+static void _free_loader(struct loader *ld) {
+    pthread_mutex_destroy(&ld->lock);
+    pthread_cond_destroy(&ld->cond);
+    _free_files(&ld->out);
+    free(ld->path);
+    free(ld);
+}
+
+// small chunks are stat'ed right away, bigger ones on the loader's ring or
+// its pool
+static void _stat_files(struct loader *ld, struct files_list *list, int dir_fd, size_t *syscalls) {
+    struct stat_job job = { .list = list, .dir_fd = dir_fd };
+    if (list->buf_sz > STAT_BATCH) {
+#ifdef _USE_URING
+        if (!ld->ring_tried) ld->ring_tried = 1, uring_init(&ld->ring, URING_ENTRIES);
+        if (ld->ring.fd >= 0) return _stat_uring(&ld->ring, list, dir_fd, syscalls);
+#endif
+        if (!ld->pool) pool_init(ld->pool = malloc(sizeof(struct pool)), STAT_THREADS);
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    if (ld->pool) pool_for(ld->pool, list->buf_sz, STAT_BATCH, _stat_batch, &job);
+    else _stat_batch(&job, 0, list->buf_sz);
+    pthread_mutex_destroy(&job.lock);
+    *syscalls += job.syscalls;
+}
+
+static void _free_stat_workers(struct loader *ld) {
+    if (ld->pool) {
+        pool_free(ld->pool);
+        free(ld->pool);
+        ld->pool = NULL;
+    }
+#ifdef _USE_URING
+    if (ld->ring_tried) uring_free(&ld->ring);
+#endif
+}
+
+static inline int _load_canceled(struct loader *ld) {
+    pthread_mutex_lock(&ld->lock);
+    const int cancel = ld->cancel;
+    pthread_mutex_unlock(&ld->lock);
+    return cancel;
+}
+
+static void _wake_ui(void) {
+    char c = 0;
+    write(lfm.wake[1], &c, 1);
+}
+
+// the reading side is done, the ui frees the loader once it took the rest
+// unless it's gone already
+static void _load_done(struct loader *ld) {
+    pthread_mutex_lock(&ld->lock);
+    const int cancel = ld->cancel;
+    ld->done = 1;
+    pthread_mutex_unlock(&ld->lock);
+    if (cancel) _free_loader(ld);
+    else _wake_ui();
+}
+
+// entries are only read once the ui watches the directory, so nothing
+// changed in between goes missing
+static int _open_loaded(struct loader *ld) {
+    const int fd = open(ld->path, O_RDONLY|O_DIRECTORY|O_CLOEXEC), err = errno;
+    pthread_mutex_lock(&ld->lock);
+    ld->fd = fd, ld->err = fd < 0? err : 0;
+    ld->opened = 1;
+    pthread_mutex_unlock(&ld->lock);
+    if (fd < 0) return -1;
+    _wake_ui();
+    pthread_mutex_lock(&ld->lock);
+    while (!ld->watched && !ld->cancel) pthread_cond_wait(&ld->cond, &ld->lock);
+    pthread_mutex_unlock(&ld->lock);
+    _open_reader(&ld->rd, fd);
+    return 0;
+}
+
+static void *_load_worker(void *arg) {
+    struct loader *ld = arg;
+    struct files_list part;
+    struct linux_dirent64 *ent;
+    size_t total = 0;
+    if (_open_loaded(ld)) {
+        _load_done(ld);
+        return NULL;
+    }
+    _init_like(&part, &ld->out);
+    while (!ld->rd.end && !_load_canceled(ld)) {
+        _clear_files(&part);
+        // chunks grow with the listing so merging them stays O(n log n)
+        const size_t chunk = MAX(LOAD_CHUNK, total);
+        while (part.sz < chunk && (ent = _read_dent(&ld->rd)) != NULL) {
+            const char *name = ent->d_name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+            if (!ld->show_hidden && name[0] == '.') continue;
+            struct file file = { .type = ent->d_type };
+            if (ld->lazy) {
+                // directories only miss their metadata, if it's kept at all
+                file.type = ent->d_type == DT_DIR? T_DIR : T_FILE;
+                file.is_link = ent->d_type == DT_LNK;
+                file.pending = ent->d_type != DT_DIR || part.meta;
+            }
+            _append_file(&part, file, name);
+        }
+        size_t syscalls = 0;
+        if (!ld->lazy) _stat_files(ld, &part, ld->rd.fd, &syscalls);
+        _sort_files(&part);
+        total += part.sz;
+        pthread_mutex_lock(&ld->lock);
+        if (ld->out.sz) _merge_files(&ld->out, _append_files(&ld->out, &part));
+        else {
+            // the ui took everything, the chunk is handed over as it is
+            struct files_list out = ld->out;
+            ld->out = part, part = out;
+        }
+        ld->syscalls += syscalls;
+        pthread_mutex_unlock(&ld->lock);
+        if (!ld->replace) _wake_ui();
+    }
+    _close_reader(&ld->rd);
+    _free_files(&part);
+    _free_stat_workers(ld);
+    _load_done(ld);
+    return NULL;
+}
+
+static void _cancel_load(struct listing *ls) {
+    struct loader *ld = ls->loader;
+    if (!ld) return;
+    ls->loader = NULL;
+    ls->stale = 1;
+    pthread_mutex_lock(&ld->lock);
+    const int done = ld->done;
+    ld->cancel = 1;
+    pthread_cond_signal(&ld->cond);
+    pthread_mutex_unlock(&ld->lock);
+    if (done) _free_loader(ld);
+}
+
+static struct loader *_new_loader(struct listing *ls) {
+    struct loader *ld = calloc(1, sizeof(struct loader));
+    pthread_mutex_init(&ld->lock, NULL);
+    pthread_cond_init(&ld->cond, NULL);
+    _init_like(&ld->out, &ls->files);
+    ld->path = strdup(ls->path);
+    ld->fd = -1;
+    ld->show_hidden = ls->show_hidden;
+    return ld;
+}
+
+static void _start_load(struct listing *ls, int replace) {
+    struct loader *ld = _new_loader(ls);
+    pthread_t thread;
+    _cancel_load(ls);
+    ld->replace = replace;
+    ld->lazy = LAZY_STAT && !SORT_META(ls->sort) && !ls->du;
+    // a directory watched already is kept up to date from the start
+    ld->watched = ls->wd >= 0;
+    ls->loader = ld;
+    ls->stale = 0;
+    if (pthread_create(&thread, NULL, _load_worker, ld)) {
+        // no thread to spare, just read it all from here
+        ld->watched = 1;
+        _load_worker(ld);
+    } else pthread_detach(thread);
+}
+
+// a directory of a search, its fd stays open until none of its
+// subdirectories has to be opened relative to it anymore. path is
+// relative to the root of the search, its last component starts at name.
+struct find_dir {
+    struct find_dir *parent;
+    int fd, refs, depth;
+    size_t sz, name;
+    char path[];
+};
+
+// a walk handing what matches to the loader of a listing
+struct finder {
+    struct loader *ld; // opens the root like any other loader would
+    struct find_dir *root;
+    struct walk walk;
+    int depth, show_hidden;
+    char *pattern;
+};
+
+struct find_worker {
+    struct finder *fi;
+    struct files_list part; // matches the loader doesn't have yet
+    struct timespec flushed;
+    size_t syscalls, errors;
+    int id;
+};
+
+static struct find_dir *_find_dir(struct find_dir *parent, const char *name) {
+    const size_t at = parent->sz? parent->sz+1 : 0, sz = at+strlen(name);
+    struct find_dir *dir = malloc(sizeof(struct find_dir)+sz+1);
+    dir->parent = parent;
+    dir->fd = -1;
+    dir->refs = 1;
+    dir->depth = parent->depth+1;
+    dir->sz = sz, dir->name = at;
+    memcpy(dir->path, parent->path, parent->sz);
+    if (at) dir->path[at-1] = '/';
+    memcpy(dir->path+at, name, sz-at+1);
+    __atomic_add_fetch(&parent->refs, 1, __ATOMIC_RELAXED);
+    return dir;
+}
+
+// drops a reference on dir, the last one closes it and goes on up
+static void _find_release(struct find_dir *dir) {
+    while (dir && !__atomic_sub_fetch(&dir->refs, 1, __ATOMIC_ACQ_REL)) {
+        struct find_dir *parent = dir->parent;
+        if (dir->fd >= 0) close(dir->fd);
+        free(dir);
+        dir = parent;
+    }
+}
+
+static inline long _ms_since(const struct timespec *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec-t->tv_sec)*1000 + (now.tv_nsec-t->tv_nsec)/1000000;
+}
+
+// hands the matches over sorted, so merging them in stays linear
+static void _find_flush(struct find_worker *w) {
+    struct loader *ld = w->fi->ld;
+    clock_gettime(CLOCK_MONOTONIC, &w->flushed);
+    if (!w->part.sz && !w->syscalls && !w->errors) return;
+    _sort_files(&w->part);
+    pthread_mutex_lock(&ld->lock);
+    _merge_files(&ld->out, _append_files(&ld->out, &w->part));
+    ld->syscalls += w->syscalls;
+    ld->errors += w->errors;
+    pthread_mutex_unlock(&ld->lock);
+    if (w->part.sz) _wake_ui();
+    _clear_files(&w->part);
+    w->syscalls = w->errors = 0;
+}
+
+// matches are classified like the entries of a listing, only symlinks
+// to directories are never followed
+static void _find_list(struct find_worker *w, struct find_dir *dir, char *buf) {
+    struct finder *fi = w->fi;
+    struct files_list *part = &w->part;
+    const int descend = !fi->depth || dir->depth+1 < fi->depth;
+    char path[PATH_MAX];
+    long n;
+    if (_load_canceled(fi->ld)) return;
+    if (dir->fd < 0) dir->fd = openat(dir->parent->fd, dir->path+dir->name, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+    // directories that can't be read are skipped and counted
+    if (dir->fd < 0) {
+        ++w->errors;
+        return;
+    }
+    while ((n = syscall(SYS_getdents64, dir->fd, buf, WALK_DENTS)) > 0) {
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64 *ent = (void*)(buf+off);
+            off += ent->d_reclen;
+            const char *name = ent->d_name;
+            unsigned char type = ent->d_type;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+            if (!fi->show_hidden && name[0] == '.') continue;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                ++w->syscalls;
+                if (!fstatat(dir->fd, name, &st, AT_SYMLINK_NOFOLLOW)) type = IFTODT(st.st_mode);
+            }
+            if (dir->sz+1+strlen(name) >= sizeof(path)) continue;
+            if (strcasestr(name, fi->pattern)) {
+                sprintf(path, "%s%s%s", dir->path, dir->sz? "/" : "", name);
+                struct file_meta meta;
+                _append_file(part, _stat_file(dir->fd, name, type, &w->syscalls, part->meta? &meta : NULL), path);
+                if (part->meta) part->meta[part->buf_sz-1] = meta;
+            }
+            if (type == DT_DIR && descend) walk_push(&fi->walk, w->id, _find_dir(dir, name));
+        }
+        if (_load_canceled(fi->ld)) break;
+    }
+    if (n < 0) ++w->errors;
+}
+
+static void *_find_worker(void *arg) {
+    struct find_worker *w = arg;
+    struct finder *fi = w->fi;
+    char *buf = malloc(WALK_DENTS);
+    struct find_dir *dir;
+    _init_like(&w->part, &fi->ld->out);
+    clock_gettime(CLOCK_MONOTONIC, &w->flushed);
+    for (;;) {
+        if ((dir = walk_take(&fi->walk, w->id)) != NULL) {
+            _find_list(w, dir, buf);
+            _find_release(dir);
+            if (w->part.sz >= LOAD_CHUNK || _ms_since(&w->flushed) >= WALK_FLUSH_MS) _find_flush(w);
+            walk_done(&fi->walk);
+            continue;
+        }
+        // nothing to take, what was found shows up while waiting
+        _find_flush(w);
+        if (walk_wait(&fi->walk)) break;
+    }
+    _free_files(&w->part);
+    free(buf);
+    return NULL;
+}
+
+// the loader is done once every worker is
+static void *_find_main(void *arg) {
+    struct finder *fi = arg;
+    struct find_worker *workers = calloc(fi->walk.num, sizeof(struct find_worker));
+    for (int i = 0; i < fi->walk.num; ++i) workers[i].fi = fi, workers[i].id = i;
+    const int fd = open(fi->ld->path, O_RDONLY|O_DIRECTORY|O_CLOEXEC), err = errno;
+    if (fd < 0) {
+        pthread_mutex_lock(&fi->ld->lock);
+        fi->ld->err = err;
+        pthread_mutex_unlock(&fi->ld->lock);
+        _find_release(fi->root);
+    } else {
+        fi->root->fd = fd;
+        walk_push(&fi->walk, 0, fi->root);
+        walk_run(&fi->walk, _find_worker, workers, sizeof(struct find_worker));
+    }
+    walk_free(&fi->walk);
+    free(workers);
+    _load_done(fi->ld);
+    free(fi->pattern);
+    free(fi);
+    return NULL;
+}
+
+// searches the tree under the listing's directory for entries named like
+// its pattern. searches aren't watched.
+static void _start_find(struct listing *ls) {
+    struct loader *ld = _new_loader(ls);
+    struct finder *fi = calloc(1, sizeof(struct finder));
+    struct find_dir *root = calloc(1, sizeof(struct find_dir)+1);
+    pthread_t thread;
+    ld->watched = 1;
+    root->fd = -1, root->refs = 1;
+    fi->ld = ld, fi->root = root;
+    walk_init(&fi->walk, FIND_THREADS);
+    fi->depth = FIND_DEPTH, fi->show_hidden = ls->show_hidden;
+    fi->pattern = strdup(ls->find);
+    ls->loader = ld;
+    ls->stale = 0;
+    if (pthread_create(&thread, NULL, _find_main, fi)) {
+        // no thread to spare, just walk it all from here
+        _find_main(fi);
+    } else pthread_detach(thread);
+}
+
+static inline int _same_time(struct timespec a, struct timespec b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+static inline size_t _du_slot(dev_t dev, ino_t ino, size_t cap) {
+    const uint64_t hash = ((uint64_t)ino ^ (uint64_t)dev << 40) * 0x9e3779b97f4a7c15ull;
+    return (hash >> 32) & (cap-1);
+}
+
+// what's below a directory if it was summed up since it last changed.
+// changes further down than its own entries don't touch its mtime, so
+// they only show once the listing is reloaded, which forgets every sum.
+static int _du_cached(const struct stat *st, int64_t *bytes) {
+    int found = 0;
+    pthread_rwlock_rdlock(&lfm.du.lock);
+    for (size_t i = lfm.du.cap? _du_slot(st->st_dev, st->st_ino, lfm.du.cap) : 0; lfm.du.cap; i = (i+1) & (lfm.du.cap-1)) {
+        const struct du_entry *e = &lfm.du.buf[i];
+        if (!e->ino) break;
+        if (e->ino != st->st_ino || e->dev != st->st_dev) continue;
+        if ((found = _same_time(e->mtime, st->st_mtim))) *bytes = e->bytes;
+        break;
+    }
+    pthread_rwlock_unlock(&lfm.du.lock);
+    return found;
+}
+
+static struct du_entry *_du_find(struct du_entry *buf, size_t cap, dev_t dev, ino_t ino) {
+    size_t i = _du_slot(dev, ino, cap);
+    while (buf[i].ino && (buf[i].ino != ino || buf[i].dev != dev)) i = (i+1) & (cap-1);
+    return &buf[i];
+}
+
+// makes room for one more entry in a table of sz of them
+static void _du_reserve(struct du_entry **buf, size_t *cap, size_t sz) {
+    if ((sz+1)*4 <= *cap*3) return;
+    const size_t new_cap = *cap? *cap*2 : ALLOC_SIZE;
+    struct du_entry *new_buf = calloc(new_cap, sizeof(struct du_entry));
+    for (size_t i = 0; i < *cap; ++i)
+        if ((*buf)[i].ino) *_du_find(new_buf, new_cap, (*buf)[i].dev, (*buf)[i].ino) = (*buf)[i];
+    free(*buf);
+    *buf = new_buf, *cap = new_cap;
+}
+
+static void _du_store(dev_t dev, ino_t ino, struct timespec mtime, int64_t bytes) {
+    pthread_rwlock_wrlock(&lfm.du.lock);
+    _du_reserve(&lfm.du.buf, &lfm.du.cap, lfm.du.sz);
+    struct du_entry *e = _du_find(lfm.du.buf, lfm.du.cap, dev, ino);
+    if (!e->ino) ++lfm.du.sz;
+    *e = (struct du_entry){ dev, ino, mtime, bytes };
+    pthread_rwlock_unlock(&lfm.du.lock);
+}
+
+static void _clear_du(void) {
+    pthread_rwlock_wrlock(&lfm.du.lock);
+    if (lfm.du.cap) memset(lfm.du.buf, 0, lfm.du.cap*sizeof(struct du_entry));
+    lfm.du.sz = 0;
+    pthread_rwlock_unlock(&lfm.du.lock);
+}
+
+// a directory being summed up. bytes gets the sizes of its entries while
+// it's listed and what's below its subdirectories once they're done. it's
+// broken once some part of it couldn't be read, and isn't cached then.
+struct du_dir {
+    struct du_dir *parent;
+    int fd, refs, broken;
+    uint32_t top; // the entry of the listing it's under
+    int64_t bytes;
+    dev_t dev;
+    ino_t ino; // 0 until stat'ed
+    struct timespec mtime;
+    char name[];
+};
+
+// sums up every directory of a listing. whoever sees the other side gone
+// (done or canceled) frees it, like a loader.
+struct du_job {
+    pthread_mutex_t lock;
+    struct walk walk;
+    struct du_dir *root; // the listing's directory
+    int64_t *totals; // by buf index of the listing, what was found so far
+    size_t n;
+    struct du_entry *links; // files with more than one name, seen so far
+    size_t links_sz, links_cap;
+    int cancel, done;
+};
+
+struct du_worker {
+    struct du_job *job;
+    struct timespec woke;
+    int id;
+};
+
+static void _free_du(struct du_job *job) {
+    pthread_mutex_destroy(&job->lock);
+    free(job->totals);
+    free(job->links);
+    free(job);
+}
+
+// hard links count once, under whichever of their names is found first
+static int _du_first_link(struct du_job *job, const struct stat *st) {
+    pthread_mutex_lock(&job->lock);
+    _du_reserve(&job->links, &job->links_cap, job->links_sz);
+    struct du_entry *e = _du_find(job->links, job->links_cap, st->st_dev, st->st_ino);
+    const int first = !e->ino;
+    if (first) e->dev = st->st_dev, e->ino = st->st_ino, ++job->links_sz;
+    pthread_mutex_unlock(&job->lock);
+    return first;
+}
+
+static inline int _du_canceled(struct du_job *job) {
+    pthread_mutex_lock(&job->lock);
+    const int cancel = job->cancel;
+    pthread_mutex_unlock(&job->lock);
+    return cancel;
+}
+
+static struct du_dir *_du_dir(struct du_dir *parent, const char *name, const struct stat *st) {
+    const size_t sz = strlen(name)+1;
+    struct du_dir *dir = calloc(1, sizeof(struct du_dir)+sz);
+    dir->parent = parent;
+    dir->fd = -1;
+    dir->refs = 1;
+    dir->top = parent->top;
+    if (st) dir->dev = st->st_dev, dir->ino = st->st_ino, dir->mtime = st->st_mtim;
+    memcpy(dir->name, name, sz);
+    __atomic_add_fetch(&parent->refs, 1, __ATOMIC_RELAXED);
+    return dir;
+}
+
+static inline void _du_break(struct du_dir *dir) {
+    __atomic_store_n(&dir->broken, 1, __ATOMIC_RELAXED);
+}
+
+// drops a reference on dir, the last one caches what's below it and adds
+// that to its parent's
+static void _du_release(struct du_dir *dir) {
+    while (dir && !__atomic_sub_fetch(&dir->refs, 1, __ATOMIC_ACQ_REL)) {
+        struct du_dir *parent = dir->parent;
+        const int64_t bytes = __atomic_load_n(&dir->bytes, __ATOMIC_RELAXED);
+        if (dir->fd >= 0) close(dir->fd);
+        if (parent) {
+            if (__atomic_load_n(&dir->broken, __ATOMIC_RELAXED)) _du_break(parent);
+            else if (dir->ino) _du_store(dir->dev, dir->ino, dir->mtime, bytes);
+            __atomic_add_fetch(&parent->bytes, bytes, __ATOMIC_RELAXED);
+        }
+        free(dir);
+        dir = parent;
+    }
+}
+
+// like du -b, every entry counts its apparent size, symlinks aren't
+// followed and hard links count once. subdirectories summed up before
+// aren't gone into again.
+static void _du_list(struct du_worker *w, struct du_dir *dir, char *buf) {
+    struct du_job *job = w->job;
+    int64_t *total = &job->totals[dir->top], bytes = 0;
+    struct stat st;
+    long n;
+    if (_du_canceled(job)) return _du_break(dir);
+    if (!dir->ino) {
+        // entries of the listing come in without a stat
+        if (fstatat(dir->parent->fd, dir->name, &st, AT_SYMLINK_NOFOLLOW)) return _du_break(dir);
+        dir->dev = st.st_dev, dir->ino = st.st_ino, dir->mtime = st.st_mtim;
+        __atomic_add_fetch(total, st.st_size, __ATOMIC_RELAXED);
+        if (_du_cached(&st, &bytes)) {
+            __atomic_add_fetch(&dir->bytes, bytes, __ATOMIC_RELAXED);
+            __atomic_add_fetch(total, bytes, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    dir->fd = openat(dir->parent->fd, dir->name, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+    if (dir->fd < 0) return _du_break(dir);
+    while ((n = syscall(SYS_getdents64, dir->fd, buf, WALK_DENTS)) > 0) {
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64 *ent = (void*)(buf+off);
+            int64_t below;
+            off += ent->d_reclen;
+            const char *name = ent->d_name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+            if (fstatat(dir->fd, name, &st, AT_SYMLINK_NOFOLLOW)) continue;
+            if (!S_ISDIR(st.st_mode) && st.st_nlink > 1 && !_du_first_link(job, &st)) continue;
+            bytes += st.st_size;
+            if (!S_ISDIR(st.st_mode)) continue;
+            if (_du_cached(&st, &below)) bytes += below;
+            else walk_push(&job->walk, w->id, _du_dir(dir, name, &st));
+        }
+        __atomic_add_fetch(&dir->bytes, bytes, __ATOMIC_RELAXED);
+        __atomic_add_fetch(total, bytes, __ATOMIC_RELAXED);
+        bytes = 0;
+        if (_du_canceled(job)) return _du_break(dir);
+    }
+    if (n < 0) _du_break(dir);
+}
+
+static void *_du_worker(void *arg) {
+    struct du_worker *w = arg;
+    struct du_job *job = w->job;
+    char *buf = malloc(WALK_DENTS);
+    struct du_dir *dir;
+    clock_gettime(CLOCK_MONOTONIC, &w->woke);
+    for (;;) {
+        if ((dir = walk_take(&job->walk, w->id)) != NULL) {
+            _du_list(w, dir, buf);
+            _du_release(dir);
+            if (_ms_since(&w->woke) >= WALK_FLUSH_MS) {
+                clock_gettime(CLOCK_MONOTONIC, &w->woke);
+                _wake_ui();
+            }
+            walk_done(&job->walk);
+            continue;
+        }
+        if (walk_wait(&job->walk)) break;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *_du_main(void *arg) {
+    struct du_job *job = arg;
+    struct du_worker *workers = calloc(job->walk.num, sizeof(struct du_worker));
+    for (int i = 0; i < job->walk.num; ++i) workers[i].job = job, workers[i].id = i;
+    walk_run(&job->walk, _du_worker, workers, sizeof(struct du_worker));
+    walk_free(&job->walk);
+    _du_release(job->root);
+    free(workers);
+    pthread_mutex_lock(&job->lock);
+    const int cancel = job->cancel;
+    job->done = 1;
+    pthread_mutex_unlock(&job->lock);
+    if (cancel) _free_du(job);
+    else _wake_ui();
+    return NULL;
+}
+
+static void _cancel_du(struct listing *ls) {
+    struct du_job *job = ls->du_job;
+    if (!job) return;
+    ls->du_job = NULL;
+    pthread_mutex_lock(&job->lock);
+    const int done = job->done;
+    job->cancel = 1;
+    pthread_mutex_unlock(&job->lock);
+    if (done) _free_du(job);
+}
+
+// sizes every directory of a complete listing by what's below it, the
+// totals go into its metadata as they come
+static void _start_du(struct listing *ls) {
+    struct files_list *list = &ls->files;
+    struct du_job *job;
+    pthread_t thread;
+    const int dir_fd = open(ls->path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    _cancel_du(ls);
+    ls->du_again = 0;
+    if (dir_fd < 0) return;
+    job = calloc(1, sizeof(struct du_job));
+    job->root = calloc(1, sizeof(struct du_dir)+1);
+    job->root->fd = dir_fd, job->root->refs = 1;
+    job->totals = malloc(MAX(list->buf_sz, 1)*sizeof(int64_t));
+    job->n = list->buf_sz;
+    pthread_mutex_init(&job->lock, NULL);
+    walk_init(&job->walk, DU_THREADS);
+    for (size_t i = 0; i < list->buf_sz; ++i) job->totals[i] = list->meta[i].size;
+    for (size_t i = 0; i < list->sz; ++i) {
+        const uint32_t idx = list->order[i];
+        if (list->buf[idx].type != T_DIR || list->buf[idx].is_link) continue;
+        job->totals[idx] = 0;
+        job->root->top = idx;
+        walk_push(&job->walk, 0, _du_dir(job->root, list->names+list->buf[idx].name, NULL));
+    }
+    ls->du_job = job;
+    if (pthread_create(&thread, NULL, _du_main, job)) {
+        // no thread to spare, just sum it all up from here
+        _du_main(job);
+    } else pthread_detach(thread);
+}
+
+static void _clamp_view(struct tab *tab) {
+    if (tab->cur >= (int)tab->files->sz) tab->cur = tab->files->sz? tab->files->sz-1 : 0;
+    if (tab->off > tab->cur) tab->off = tab->cur;
+    if (tab->cur-tab->off > lfm.wh-2) tab->off = tab->cur-lfm.wh+2;
+    if (tab->off < 0) tab->off = 0;
+}
+
+// puts the cursor on the file the tab is waiting for once it's there,
+// or gives up on it when the listing is complete.
+static void _resolve_want(struct tab *tab) {
+    if (!tab->want) return;
+    const int idx = _find_name(tab->files, tab->want);
+    if (idx != -1 || !tab->ls->loader) {
+        if (idx != -1) tab->cur = idx, tab->off = idx-tab->want_row;
+        free(tab->want);
+        tab->want = NULL;
+    }
+    _clamp_view(tab);
+}
+
+static void _put_cursor(struct tab *tab, uint32_t mark, int row) {
+    for (size_t i = 0; i < tab->files->sz; ++i) {
+        if (tab->files->order[i] != mark) continue;
+        tab->cur = i, tab->off = i-row;
+        break;
+    }
+    _clamp_view(tab);
+}
+
+static inline uint32_t _cursor_mark(struct tab *tab) {
+    return tab->files->sz? tab->files->order[tab->cur] : UINT32_MAX;
+}
+
+// entries never change once appended, only the new ones need a mask
+static void _update_masks(struct files_list *list) {
+    if (list->masks && list->masks_sz == list->buf_sz) return;
+    list->masks = realloc(list->masks, list->buf_cap*sizeof(uint64_t));
+    for (size_t i = list->masks_sz; i < list->buf_sz; ++i)
+        list->masks[i] = fuzzy_mask(list->names+list->buf[i].name, list->buf[i].name_sz);
+    list->masks_sz = list->buf_sz;
+}
+
+// scores entries in[from, to) into the same slots of scores. without in
+// it goes over the entries in the order they were read, so the arena is
+// read front to back instead of jumping around in the listing's order.
+struct match_job {
+    struct files_list *all;
+    const uint32_t *in;
+    int32_t *scores;
+    char needle[FILTER_MAX+1];
+    struct fuzzy fz;
+    int fuzzy;
+};
+
+static void _match_batch(void *arg, size_t from, size_t to) {
+    struct match_job *job = arg;
+    const uint64_t want = job->fz.mask, *masks = job->all->masks;
+    if (!job->in) fuzzy_prefilter(want, masks+from, to-from, job->scores+from);
+    for (size_t i = from; i < to; ++i) {
+        const uint32_t idx = job->in? job->in[i] : i;
+        if (job->in? (masks[idx] & want) != want : job->scores[i] < 0) {
+            job->scores[i] = -1;
+            continue;
+        }
+        const struct file *file = &job->all->buf[idx];
+        const char *name = job->all->names+file->name;
+        if (job->fuzzy) job->scores[i] = fuzzy_match(&job->fz, name, file->name_sz);
+        else job->scores[i] = strcasestr(name, job->needle)? 0 : -1;
+    }
+}
+
+// narrows the set of the level above down to the entries matching the
+// first k bytes of the pattern, level 0 being the whole listing. big sets
+// are split across the pool. fuzzy matches are ranked by their score,
+// then shorter names and then the listing's order.
+static void _refine(struct filter *f, int k) {
+    struct match_job job = { .all = &f->ls->files, .fuzzy = f->fuzzy };
+    const size_t n = k > 1? f->sizes[k-1] : job.all->buf_sz;
+    struct sort_key *keys = f->fuzzy? malloc(n*2*sizeof(struct sort_key)) : NULL;
+    size_t sz = 0;
+    job.in = k > 1? f->sets[k-1] : NULL;
+    memcpy(job.needle, f->pattern, k);
+    job.needle[k] = 0;
+    fuzzy_init(&job.fz, f->pattern, k);
+    _update_masks(job.all);
+    if (f->scores_cap < n) f->scores = realloc(f->scores, (f->scores_cap = n)*sizeof(int32_t));
+    job.scores = f->scores;
+    if (n >= FILTER_SPLIT) pool_for(&lfm.pool, n, FILTER_BATCH, _match_batch, &job);
+    else _match_batch(&job, 0, n);
+    if (k == 1 && f->fuzzy && f->pos_cap < n) f->pos = realloc(f->pos, (f->pos_cap = n)*sizeof(uint32_t));
+    const size_t m = k > 1? n : job.all->sz;
+    if (f->caps[k] < m) f->sets[k] = realloc(f->sets[k], (f->caps[k] = m)*sizeof(uint32_t));
+    for (size_t i = 0; i < m; ++i) {
+        const uint32_t idx = job.in? job.in[i] : job.all->order[i];
+        const int32_t score = f->scores[job.in? i : idx];
+        if (score < 0) continue;
+        if (!f->fuzzy) {
+            f->sets[k][sz++] = idx;
+            continue;
+        }
+        if (k == 1) f->pos[idx] = i;
+        keys[sz++] = (struct sort_key){ (uint64_t)(0xffffff-MIN(score, 0xffffff)) << 40
+            | (uint64_t)MIN(job.all->buf[idx].name_sz, 0xff) << 32 | f->pos[idx], idx };
+    }
+    f->sizes[k] = sz;
+    if (!f->fuzzy) return;
+    // keys are all different, the listing is only there for the signature
+    _radix_sort(keys, keys+sz, sz, 56, job.all);
+    for (size_t i = 0; i < sz; ++i) f->sets[k][i] = keys[i].idx;
+    free(keys);
+}
+
+// shows the last set, the view borrows everything else from the listing
+static void _update_view(struct tab *tab, uint32_t mark, int row) {
+    struct filter *f = tab->filter;
+    if (!f->depth) {
+        tab->files = &f->ls->files;
+        return _put_cursor(tab, mark, row);
+    }
+    f->view = f->ls->files;
+    f->view.order = f->sets[f->depth];
+    f->view.sz = f->view.cap = f->sizes[f->depth];
+    tab->files = &f->view;
+    _put_cursor(tab, mark, row);
+}
+
+// makes the sets again if the listing changed since, a filtered view
+// mustn't be looked at before.
+static void _sync_filter(struct tab *tab) {
+    struct filter *f = tab->filter;
+    if (!f || (f->ls == tab->ls && f->gen == tab->ls->gen)) return;
+    const uint32_t mark = (f->ls == tab->ls)? _cursor_mark(tab) : UINT32_MAX;
+    f->ls = tab->ls, f->gen = tab->ls->gen;
+    for (int k = 1; k <= f->depth; ++k) _refine(f, k);
+    _update_view(tab, mark, tab->cur-tab->off);
+}
+
+static void _free_filter(struct tab *tab) {
+    struct filter *f = tab->filter;
+    if (!f) return;
+    for (int k = 0; k <= FILTER_MAX; ++k) free(f->sets[k]);
+    free(f->scores);
+    free(f->pos);
+    free(f);
+    tab->filter = NULL;
+    tab->files = tab->ls? &tab->ls->files : NULL;
+}
+
+// back to the whole listing, still on the same entry
+static void _drop_filter(struct tab *tab) {
+    if (!tab->filter) return;
+    _sync_filter(tab);
+    const uint32_t mark = _cursor_mark(tab);
+    const int row = tab->cur-tab->off;
+    _free_filter(tab);
+    _put_cursor(tab, mark, row);
+}
+
+// first index of the bucket (directories or not) entry whose name doesn't
+// sort before name, for listings ordered by bucket and then by name.
+static size_t _lower_bound(struct files_list *list, int is_dir, const char *name) {
+    size_t lo = 0, hi = list->sz;
+    while (lo < hi) {
+        const size_t mid = lo+(hi-lo)/2;
+        const int mid_dir = FILE_AT(list, mid).type == T_DIR;
+        const int c = (mid_dir != is_dir)? (mid_dir? -1 : 1) : strcasecmp(FILE_NAME(list, mid), name);
+        if (c < 0) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int _search_file(struct files_list *list, const char *name) {
+    if (list->sort != SORT_NAME) return _find_name(list, name);
+    for (int is_dir = 1; is_dir >= 0; --is_dir) {
+        for (size_t i = _lower_bound(list, is_dir, name); i < list->sz; ++i) {
+            if ((FILE_AT(list, i).type == T_DIR) != is_dir || strcasecmp(FILE_NAME(list, i), name)) break;
+            if (!strcmp(FILE_NAME(list, i), name)) return i;
+        }
+    }
+    return -1;
+}
+
+// cursors stay on their file and views on their first row, filtered
+// tabs catch up once their sets are made again.
+// XXX: the name stays in the arena until the next full listing
+static void _remove_entry(struct listing *ls, int idx) {
+    _remove_file(&ls->files, idx);
+    ++ls->gen;
+    for (struct tab *tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) {
+        if (tab->ls != ls || tab->files != &ls->files) continue;
+        if (idx < tab->cur) --tab->cur;
+        if (idx < tab->off) --tab->off;
+        _clamp_view(tab);
+    }
+}
+
+// where the entry at buf index entry goes among the others in order
+static size_t _insert_pos(struct files_list *list, uint32_t entry) {
+    size_t lo = 0, hi = list->sz;
+    while (lo < hi) {
+        const size_t mid = lo+(hi-lo)/2;
+        if (_compare_entries(list, list->order[mid], entry) < 0) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void _insert_entry(struct listing *ls, struct file file, const char *name, struct file_meta meta) {
+    struct files_list *list = &ls->files;
+    char path[PATH_MAX];
+    if (lfm.selection.sz) {
+        snprintf(path, sizeof(path), "%s/%s", ls->path, name);
+        file.selected = strset_has(&lfm.selection, path);
+    }
+    _append_file(list, file, name);
+    const uint32_t entry = list->order[--list->sz];
+    if (list->meta) list->meta[entry] = meta;
+    const size_t idx = _insert_pos(list, entry);
+    ++list->sz;
+    memmove(list->order+idx+1, list->order+idx, (list->sz-1-idx)*sizeof(uint32_t));
+    list->order[idx] = entry;
+    ++ls->gen;
+    for (struct tab *tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) {
+        if (tab->ls != ls || tab->files != &ls->files) continue;
+        if (idx <= tab->cur && list->sz > 1) ++tab->cur;
+        if (idx < tab->off) ++tab->off;
+        _clamp_view(tab);
+    }
+}
+
+// something happened to name, look at it again and update the listing
+static void _revalidate(struct listing *ls, const char *name) {
+    char path[PATH_MAX];
+    struct stat file_stat;
+    const int idx = _search_file(&ls->files, name);
+    snprintf(path, sizeof(path), "%s/%s", ls->path, name);
+    ++ls->syscalls;
+    const int exists = !fstatat(AT_FDCWD, path, &file_stat, AT_SYMLINK_NOFOLLOW);
+    if (idx != -1) _remove_entry(ls, idx);
+    if (exists && (ls->show_hidden || name[0] != '.')) {
+        const unsigned char type = S_ISLNK(file_stat.st_mode)? DT_LNK : IFTODT(file_stat.st_mode);
+        struct file_meta meta = {0};
+        struct file file = _stat_file(AT_FDCWD, path, type, &ls->syscalls, ls->files.meta? &meta : NULL);
+        int64_t below;
+        // a directory of a du listing is summed up again unless it didn't change
+        if (ls->du && file.type == T_DIR && !file.is_link) {
+            if (_du_cached(&file_stat, &below)) meta.size = file_stat.st_size+below;
+            else ls->du_again = 1;
+        }
+        _insert_entry(ls, file, name, meta);
+    }
+}
+
+static void _unwatch(struct listing *ls) {
+    const int wd = ls->wd;
+    if (wd < 0) return;
+    ls->wd = -1;
+    for (struct listing *l = lfm.listings; l; l = l->next)
+        if (l->wd == wd) return;
+    inotify_rm_watch(lfm.inotify, wd);
+}
+
+// listings of the same directory share the watch, inotify hands out one
+// per inode. it's added through the loader's fd so the path isn't looked
+// up again on a mount that may hang.
+static void _watch(struct listing *ls, int fd) {
+    char proc[64];
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    int wd = inotify_add_watch(lfm.inotify, proc, IN_ONLYDIR|IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ATTRIB|IN_CLOSE_WRITE);
+    if (wd < 0 && errno == ENOENT) wd = inotify_add_watch(lfm.inotify, ls->path, IN_ONLYDIR|IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ATTRIB|IN_CLOSE_WRITE);
+    if (wd != ls->wd) _unwatch(ls);
+    ls->wd = wd;
+}
+
+static struct listing *_new_listing(const char *path, int show_hidden, int sort, int du) {
+    struct listing *ls = calloc(1, sizeof(struct listing));
+    _init_files(&ls->files);
+    ls->files.sort = ls->sort = sort;
+    if (lfm.keep_meta || du) _init_meta(&ls->files);
+    _init_files(&ls->dirty);
+    ls->path = strdup(path);
+    ls->show_hidden = show_hidden;
+    ls->du = du;
+    ls->last_mark = UINT32_MAX;
+    ls->sel_gen = lfm.sel_gen;
+    ls->wd = -1;
+    if ((ls->next = lfm.listings)) ls->next->prev = ls;
+    lfm.listings = ls;
+    return ls;
+}
+
+static void _free_listing(struct listing *ls) {
+    _cancel_load(ls);
+    _cancel_lazy(ls);
+    _cancel_du(ls);
+    if (ls->prev) ls->prev->next = ls->next;
+    else lfm.listings = ls->next;
+    if (ls->next) ls->next->prev = ls->prev;
+    _unwatch(ls);
+    _free_files(&ls->files);
+    _free_files(&ls->dirty);
+    free(ls->path);
+    free(ls->find);
+    free(ls);
+}
+
+static inline size_t _listing_size(struct listing *ls) {
+    return sizeof(struct listing) + ls->files.cap*sizeof(uint32_t) + ls->files.buf_cap*sizeof(struct file) + ls->files.names_cap
+        + (ls->files.meta? ls->files.buf_cap*sizeof(struct file_meta) : 0) + (ls->files.masks? ls->files.buf_cap*sizeof(uint64_t) : 0);
+}
+
+// listings no tab uses stay around, least recently used ones go first
+// once they take more than CACHE_SIZE.
+static void _trim_cache(void) {
+    struct listing *ls = lfm.listings, *prev;
+    size_t total = 0;
+    if (!ls) return;
+    while (ls->next) ls = ls->next;
+    for (struct listing *l = ls; l; l = l->prev)
+        if (!l->refs) total += _listing_size(l);
+    for (; ls && total > CACHE_SIZE; ls = prev) {
+        prev = ls->prev;
+        if (ls->refs) continue;
+        total -= _listing_size(ls);
+        _free_listing(ls);
+    }
+}
+
+static void _ref_listing(struct listing *ls) {
+    ++ls->refs;
+    // most recently used first
+    if (ls != lfm.listings) {
+        ls->prev->next = ls->next;
+        if (ls->next) ls->next->prev = ls->prev;
+        ls->prev = NULL;
+        ls->next = lfm.listings;
+        lfm.listings = lfm.listings->prev = ls;
+    }
+}
+
+static void _unref_listing(struct listing *ls) {
+    if (!ls || --ls->refs) return;
+    // half read or sized listings aren't worth keeping, searches can't be found again
+    if (ls->loader || ls->du_job || ls->stale || ls->find) _free_listing(ls);
+    else _trim_cache();
+}
+
+// the listing remembers where the cursor was, if the tab leaves it as it is
+static void _set_listing(struct tab *tab, struct listing *ls) {
+    struct listing *old = tab->ls;
+    if (old && tab->files == &old->files && old->files.sz) {
+        old->last_cur = tab->cur, old->last_off = tab->off;
+        old->last_mark = old->files.order[tab->cur];
+        old->last_gen = old->gen;
+    }
+    if (ls) _ref_listing(ls);
+    tab->ls = ls;
+    tab->files = ls? &ls->files : NULL;
+    if (ls) _sync_filter(tab);
+    _unref_listing(old);
+}
+
+// a listing is good if it's still being read or a watch kept it up to
+// date, so looking one up takes no syscall. the ones nothing kept up to
+// date that nobody looks at are dropped on the way.
+static struct listing *_lookup(const char *path, int show_hidden, int sort, int du, int complete) {
+    struct listing *ls = lfm.listings, *next;
+    for (; ls; ls = next) {
+        next = ls->next;
+        if (ls->show_hidden != show_hidden || ls->sort != sort || ls->du != du || ls->find) continue;
+        if (ls->stale || strcmp(ls->path, path)) continue;
+        if (ls->loader) {
+            if (complete) continue;
+            return ls;
+        }
+        if (ls->wd >= 0) return ls;
+        if (!ls->refs) _free_listing(ls);
+    }
+    return NULL;
+}
+
+static inline int _has_meta(struct listing *ls, int du) {
+    return ls->files.meta && (du || !ls->du);
+}
+
+// sorts the listing again after the keys of its entries changed, cursors
+// stay on their entry unless they're at the very top
+static void _resort(struct listing *ls) {
+    struct files_list *list = &ls->files;
+    struct tab *tab;
+    for (tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab)
+        if (tab->ls == ls) tab->mark = tab->files == list && (tab->cur || tab->off)? (int)_cursor_mark(tab) : -1;
+    _sort_files(list);
+    ++ls->gen;
+    for (tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) {
+        if (tab->ls != ls) continue;
+        _sync_filter(tab);
+        if (tab->mark < 0) continue;
+        _put_cursor(tab, tab->mark, tab->cur-tab->off);
+        // entries only moved, so no rows are left empty at the bottom
+        tab->off = MIN(tab->off, MAX((int)tab->files->sz-(lfm.wh-1), 0));
+    }
+}
+
+// entries of a lazy listing only know what d_type told about them until
+// they're stat'ed: directories are directories, links are links and the
+// rest are plain files.
+static inline unsigned char _pending_type(const struct file *file) {
+    return file->is_link? DT_LNK : file->type == T_DIR? DT_DIR : DT_UNKNOWN;
+}
+
+struct pending_job {
+    struct files_list *list;
+    const uint32_t *idx;
+    int dir_fd, moved; // moved: some entry turned out to be in the other bucket
+    size_t syscalls;
+    pthread_mutex_t lock;
+};
+
+// what the lazy worker found out about the entry at idx of its listing
+struct lazy_stat {
+    uint32_t idx;
+    struct file file;
+    struct file_meta meta;
+};
+
+// stats the pending entries of a lazy listing on a thread of its own. it
+// has copies of them in todo, their indices in the listing in idx, and
+// the ui adds more while the listing loads. rows the ui is about to show
+// are asked for in want and go first, the rest goes in the order it was
+// read. results wait in out until the ui takes them. whoever sees the
+// other side gone frees it, like a loader.
+struct lazy_job {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char *path;
+    struct files_list todo; // pending: not taken by the worker yet
+    uint32_t *idx, *want;
+    struct lazy_stat *out;
+    size_t idx_cap, want_sz, want_cap, out_sz, out_cap, next, syscalls;
+    int cancel, done, closed; // closed: no more entries are coming
+    int threadless; // no worker could be started for it, only the ui touches it
+};
+
+static void _lazy_batch(void *arg, size_t from, size_t to) {
+    struct pending_job *job = arg;
+    struct files_list *list = job->list;
+    size_t syscalls = 0;
+    int moved = 0;
+    for (size_t i = from; i < to; ++i) {
+        const uint32_t idx = job->idx[i];
+        struct file *file = &list->buf[idx];
+        struct file res = _stat_file(job->dir_fd, list->names+file->name, _pending_type(file), &syscalls, list->meta? &list->meta[idx] : NULL);
+        moved |= (res.type == T_DIR) != (file->type == T_DIR);
+        file->is_link = res.is_link, file->type = res.type, file->pending = 0;
+    }
+    pthread_mutex_lock(&job->lock);
+    job->syscalls += syscalls;
+    job->moved |= moved;
+    pthread_mutex_unlock(&job->lock);
+}
+
+// stats the pending entries idx[0, n) of the listing right away
+static void _stat_pending(struct listing *ls, const uint32_t *idx, size_t n) {
+    struct pending_job job = { .list = &ls->files, .idx = idx };
+    if (!n || (job.dir_fd = open(ls->path, O_RDONLY|O_DIRECTORY|O_CLOEXEC)) < 0) return;
+    pthread_mutex_init(&job.lock, NULL);
+    pool_for(&lfm.pool, n, STAT_BATCH, _lazy_batch, &job);
+    pthread_mutex_destroy(&job.lock);
+    close(job.dir_fd);
+    ls->syscalls += job.syscalls+1;
+    if (job.moved) _resort(ls);
+}
+
+static void _free_lazy(struct lazy_job *job) {
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->cond);
+    _free_files(&job->todo);
+    free(job->path);
+    free(job->idx);
+    free(job->want);
+    free(job->out);
+    free(job);
+}
+
+// up to STAT_BATCH entries to stat next, asked for ones first. their
+// names are copied out so the ui can go on adding entries meanwhile.
+static size_t _lazy_take(struct lazy_job *job, uint32_t *take, char (*names)[256], unsigned char *types, int *urgent) {
+    size_t n = 0;
+    *urgent = job->want_sz > 0;
+    for (;;) {
+        size_t j;
+        if (job->want_sz) {
+            const uint32_t idx = job->want[--job->want_sz];
+            size_t lo = 0, hi = job->todo.buf_sz;
+            while (lo < hi) {
+                const size_t mid = (lo+hi)/2;
+                if (job->idx[mid] < idx) lo = mid+1;
+                else hi = mid;
+            }
+            if (lo >= job->todo.buf_sz || job->idx[lo] != idx) continue;
+            j = lo;
+        } else if (job->next < job->todo.buf_sz) {
+            j = job->next++;
+        } else break;
+        struct file *file = &job->todo.buf[j];
+        if (!file->pending) continue;
+        file->pending = 0;
+        take[n] = job->idx[j], types[n] = _pending_type(file);
+        memcpy(names[n], job->todo.names+file->name, file->name_sz+1);
+        if (++n == STAT_BATCH) break;
+    }
+    return n;
+}
+
+static void *_lazy_worker(void *arg) {
+    struct lazy_job *job = arg;
+    struct lazy_stat res[STAT_BATCH];
+    uint32_t take[STAT_BATCH];
+    unsigned char types[STAT_BATCH];
+    char (*names)[256] = malloc(STAT_BATCH*256);
+    struct timespec flushed;
+    const int dir_fd = open(job->path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    int urgent;
+    size_t n;
+    clock_gettime(CLOCK_MONOTONIC, &flushed);
+    pthread_mutex_lock(&job->lock);
+    while (dir_fd >= 0 && !job->cancel) {
+        if (!(n = _lazy_take(job, take, names, types, &urgent))) {
+            if (job->closed) break;
+            pthread_cond_wait(&job->cond, &job->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&job->lock);
+        size_t syscalls = 0;
+        for (size_t i = 0; i < n; ++i) {
+            res[i].idx = take[i];
+            res[i].file = _stat_file(dir_fd, names[i], types[i], &syscalls, &res[i].meta);
+        }
+        pthread_mutex_lock(&job->lock);
+        if (job->out_sz+n > job->out_cap)
+            job->out = realloc(job->out, (job->out_cap = MAX(job->out_cap*2, job->out_sz+n))*sizeof(struct lazy_stat));
+        memcpy(job->out+job->out_sz, res, n*sizeof(struct lazy_stat));
+        job->out_sz += n;
+        job->syscalls += syscalls;
+        // rows on screen show up right away, the rest every now and then
+        if (urgent || _ms_since(&flushed) >= WALK_FLUSH_MS) {
+            clock_gettime(CLOCK_MONOTONIC, &flushed);
+            _wake_ui();
+        }
+    }
+    const int cancel = job->cancel;
+    job->done = 1;
+    pthread_mutex_unlock(&job->lock);
+    if (dir_fd >= 0) close(dir_fd);
+    free(names);
+    if (cancel) _free_lazy(job);
+    else _wake_ui();
+    return NULL;
+}
+
+static void _cancel_lazy(struct listing *ls) {
+    struct lazy_job *job = ls->lazy_job;
+    if (!job) return;
+    ls->lazy_job = NULL;
+    pthread_mutex_lock(&job->lock);
+    const int done = job->done;
+    job->cancel = 1;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    if (done || job->threadless) _free_lazy(job);
+}
+
+// hands the pending entries of buf[from, buf_sz) over to the listing's
+// lazy worker, starting one if there's none
+static void _queue_lazy(struct listing *ls, size_t from) {
+    struct files_list *list = &ls->files;
+    struct lazy_job *job = ls->lazy_job;
+    pthread_t thread;
+    ls->lazy = 1;
+    if (!job) {
+        job = ls->lazy_job = calloc(1, sizeof(struct lazy_job));
+        pthread_mutex_init(&job->lock, NULL);
+        pthread_cond_init(&job->cond, NULL);
+        _init_files(&job->todo);
+        job->path = strdup(ls->path);
+        if (pthread_create(&thread, NULL, _lazy_worker, job)) job->threadless = 1;
+        else pthread_detach(thread);
+    }
+    pthread_mutex_lock(&job->lock);
+    for (size_t i = from; i < list->buf_sz; ++i) {
+        if (!list->buf[i].pending) continue;
+        if (job->todo.buf_sz >= job->idx_cap)
+            job->idx = realloc(job->idx, (job->idx_cap = MAX(job->idx_cap*2, ALLOC_SIZE))*sizeof(uint32_t));
+        job->idx[job->todo.buf_sz] = i;
+        _append_file(&job->todo, list->buf[i], list->names+list->buf[i].name);
+    }
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// no more entries are coming, the worker leaves once it's through them
+static void _close_lazy(struct listing *ls) {
+    struct lazy_job *job = ls->lazy_job;
+    if (!job) return;
+    pthread_mutex_lock(&job->lock);
+    job->closed = 1;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// the pending rows [from, to) of files go first, in place of whatever
+// was asked for before
+static void _want_rows(struct listing *ls, struct files_list *files, int from, int to) {
+    struct lazy_job *job = ls->lazy_job;
+    size_t n = 0;
+    from = MAX(from, 0), to = MIN(to, (int)files->sz);
+    if (!job || from >= to) return;
+    for (int i = from; i < to; ++i) n += FILE_AT(files, i).pending;
+    if (!n) return;
+    pthread_mutex_lock(&job->lock);
+    if (n > job->want_cap) job->want = realloc(job->want, (job->want_cap = n)*sizeof(uint32_t));
+    // taken from the end, so the top row goes first
+    job->want_sz = 0;
+    for (int i = to-1; i >= from; --i)
+        if (FILE_AT(files, i).pending) job->want[job->want_sz++] = files->order[i];
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// the rows on screen and margin rows around them are asked for before
+// anything else
+static void _want_view(struct tab *tab, int margin) {
+    _want_rows(tab->ls, tab->files, tab->off-margin, tab->off+lfm.wh-1+margin);
+}
+
+// moves what the worker found out into the listing. entries changing
+// buckets make it sort again, which is why results come in bunches.
+// stats whatever is still pending from here and drops the job, for when
+// there's no thread to do it
+static void _finish_lazy(struct listing *ls) {
+    struct files_list *list = &ls->files;
+    uint32_t *idx = malloc(MAX(list->buf_sz, 1)*sizeof(uint32_t));
+    size_t n = 0;
+    for (size_t i = 0; i < list->buf_sz; ++i)
+        if (list->buf[i].pending) idx[n++] = i;
+    _free_lazy(ls->lazy_job);
+    ls->lazy_job = NULL;
+    ls->lazy = 0;
+    _stat_pending(ls, idx, n);
+    ++ls->stat_gen;
+    free(idx);
+}
+
+static void _take_stats(struct listing *ls) {
+    struct lazy_job *job = ls->lazy_job;
+    struct files_list *list = &ls->files;
+    struct lazy_stat *out;
+    pthread_t thread;
+    int moved = 0;
+    // the worker it couldn't start is tried once more before giving up on it
+    if (job->threadless) {
+        if (pthread_create(&thread, NULL, _lazy_worker, job)) return _finish_lazy(ls);
+        job->threadless = 0;
+        pthread_detach(thread);
+    }
+    pthread_mutex_lock(&job->lock);
+    const int done = job->done;
+    const size_t n = job->out_sz;
+    out = job->out;
+    job->out = NULL;
+    job->out_sz = job->out_cap = 0;
+    ls->syscalls += job->syscalls;
+    job->syscalls = 0;
+    pthread_mutex_unlock(&job->lock);
+    for (size_t i = 0; i < n; ++i) {
+        if (out[i].idx >= list->buf_sz || !list->buf[out[i].idx].pending) continue;
+        struct file *file = &list->buf[out[i].idx];
+        moved |= (out[i].file.type == T_DIR) != (file->type == T_DIR);
+        file->is_link = out[i].file.is_link, file->type = out[i].file.type, file->pending = 0;
+        if (list->meta) list->meta[out[i].idx] = out[i].meta;
+    }
+    free(out);
+    if (n) ++ls->stat_gen;
+    if (done) {
+        ls->lazy_job = NULL;
+        ls->lazy = 0;
+        _free_lazy(job);
+    }
+    if (moved) _resort(ls);
+}
+
+// builds the listing out of one of the same directory read with hidden
+// files or in another order. orders by metadata and du need all of it,
+// so they're only built out of listings that have it for every entry and
+// read by a loader otherwise. sizes of directories summed up don't count
+// as metadata for listings that aren't, the ones that are start over.
+static struct listing *_derive(const char *path, int show_hidden, int sort, int du) {
+    struct listing *src = NULL, *ls;
+    const int need_meta = SORT_META(sort) || du;
+    for (int hidden = show_hidden; hidden <= TRUE; ++hidden) {
+        for (int s = 0; s < NUM_SORTS; ++s) {
+            for (int d = FALSE; d <= TRUE; ++d) {
+                struct listing *l = (hidden != show_hidden || s != sort || d != du)? _lookup(path, hidden, s, d, TRUE) : NULL;
+                if (l && need_meta && (l->lazy || !_has_meta(l, du))) continue;
+                if (l && (!src || (!_has_meta(src, du) && _has_meta(l, du)))) src = l;
+            }
+        }
+    }
+    if (!src) return NULL;
+    const int meta = _has_meta(src, du);
+    ls = _new_listing(path, show_hidden, sort, du);
+    ls->wd = src->wd;
+    ls->sel_gen = src->sel_gen;
+    if (meta) _init_meta(&ls->files);
+    else if (ls->files.meta) {
+        free(ls->files.meta);
+        ls->files.meta = NULL;
+    }
+    for (size_t i = 0; i < src->files.sz; ++i) {
+        const char *name = FILE_NAME(&src->files, i);
+        if (!show_hidden && name[0] == '.') continue;
+        _append_file(&ls->files, FILE_AT(&src->files, i), name);
+        if (meta) ls->files.meta[ls->files.buf_sz-1] = src->files.meta[src->files.order[i]];
+    }
+    if (src->lazy) {
+        _queue_lazy(ls, 0);
+        _close_lazy(ls);
+    }
+    if (src->sort != sort) _sort_files(&ls->files);
+    if (du) _start_du(ls);
+    return ls;
+}
+
+static void _apply_event(struct inotify_event *ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        for (struct listing *ls = lfm.listings; ls; ls = ls->next) ls->stale = !ls->find;
+        for (struct tab *tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab)
+            if (tab->ls->stale && !tab->ls->loader) reload_files(tab);
+        return;
+    }
+    for (struct listing *ls = lfm.listings; ls; ls = ls->next) {
+        if (ls->wd != ev->wd) continue;
+        if (ev->mask & IN_IGNORED) ls->wd = -1;
+        else if (!ev->len) continue;
+        // loaded entries are merged later, so the name is checked once it's done
+        else if (ls->loader) _append_file(&ls->dirty, (struct file){0}, ev->name);
+        else _revalidate(ls, ev->name);
+    }
 }
 
-static void _init_files(struct files_list *list) {
-    list->buf = malloc(sizeof(struct file) * (list->cap = ALLOC_SIZE));
-    list->sz = 0;
+static void _read_events(void) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(lfm.inotify, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf+len; ) {
+            struct inotify_event *ev = (struct inotify_event*)ptr;
+            _apply_event(ev);
+            ptr += sizeof(struct inotify_event)+ev->len;
+        }
+    }
+    for (struct listing *ls = lfm.listings; ls; ls = ls->next)
+        if (ls->du_again && !ls->loader) _start_du(ls);
 }
 
-static void _free_files(struct files_list *list) {
-    free(list->buf);
-    list->sz = list->cap = 0;
+// rereads the listing only if there's no watch keeping it up to date,
+// searches only if they were cut short
+static void _refresh(struct tab *tab) {
+    if (tab->ls->stale || (tab->ls->wd < 0 && !tab->ls->find)) reload_files(tab);
 }
 
-static void _append_file(struct files_list *list, struct file file) {
-    if (list->sz >= list->cap)
-        list->buf = realloc(list->buf, sizeof(struct file) * (list->cap += ALLOC_SIZE));
-    list->buf[list->sz++] = file;
+// watches the directory the loader opened and lets it go on reading
+static void _watch_loaded(struct listing *ls) {
+    struct loader *ld = ls->loader;
+    pthread_mutex_lock(&ld->lock);
+    const int ready = ld->opened && ld->fd >= 0 && !ld->watched, fd = ld->fd;
+    pthread_mutex_unlock(&ld->lock);
+    if (!ready) return;
+    _watch(ls, fd);
+    pthread_mutex_lock(&ld->lock);
+    ld->watched = 1;
+    pthread_cond_signal(&ld->cond);
+    pthread_mutex_unlock(&ld->lock);
 }
 
-// return index of file if selected, else return -1
-static int _find_file(struct files_list *list, struct file file) {
-    for (int i = 0; i < list->sz; ++i) {
-        struct file *f = &list->buf[i];
-        if (!strcmp(f->path, file.path) && !strcmp(f->name, file.name)) return i;
+// moves whatever the loader read so far into the listing, cursors stick
+// to their entry unless they're still sitting at the very top.
+static void _take_loaded(struct listing *ls) {
+    struct loader *ld = ls->loader;
+    struct tab *tab;
+    size_t from;
+    _watch_loaded(ls);
+    pthread_mutex_lock(&ld->lock);
+    const int done = ld->done;
+    ls->syscalls = ld->syscalls;
+    ls->errors = ld->errors;
+    if (done || !ld->replace) {
+        if (ld->replace) _cancel_lazy(ls), _clear_files(&ls->files), ls->lazy = 0;
+        from = ls->files.buf_sz;
+        for (tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) {
+            if (tab->ls != ls) continue;
+            tab->mark = tab->files == &ls->files && (tab->cur || tab->off) && ls->files.sz? FILE_AT(&ls->files, tab->cur).name : -1;
+        }
+        _merge_files(&ls->files, _append_files(&ls->files, &ld->out));
+        if (ld->lazy && ls->files.buf_sz > from) _queue_lazy(ls, from);
+        ++ls->gen;
+        _clear_files(&ld->out);
+        if (lfm.selection.sz) ls->sel_gen = lfm.sel_gen-1;
+        for (tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) {
+            if (tab->ls != ls || tab->mark < 0) continue;
+            for (size_t i = 0; i < ls->files.sz; ++i) {
+                if (FILE_AT(&ls->files, i).name != tab->mark) continue;
+                tab->off += (int)i-tab->cur, tab->cur = i;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&ld->lock);
+    if (done) {
+        // a directory that can't be opened stays empty, it's tried again when reloaded
+        if (ld->err) {
+            snprintf(lfm.msg, sizeof(lfm.msg), " %s: %s", ls->path, strerror(ld->err));
+            ls->stale = 1;
+        }
+        ls->loader = NULL;
+        _free_loader(ld);
+        _close_lazy(ls);
+        for (size_t i = 0; i < ls->dirty.sz; ++i) _revalidate(ls, FILE_NAME(&ls->dirty, i));
+        _clear_files(&ls->dirty);
+        if (ls->du) _start_du(ls);
+    }
+    for (tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) {
+        if (tab->ls != ls) continue;
+        _sync_filter(tab);
+        _resolve_want(tab);
+        _clamp_view(tab);
     }
-    return -1;
 }
 
-static void _remove_file(struct files_list *list, int idx) {
-    if (list->sz == 0 || idx >= list->sz) return;
-    --list->sz;
-    for (int i = idx; i < list->sz; ++i) list->buf[i] = list->buf[i+1];
+// moves the totals summed up so far into the listing, sorting by size again
+static void _take_sizes(struct listing *ls) {
+    struct du_job *job = ls->du_job;
+    struct files_list *list = &ls->files;
+    pthread_mutex_lock(&job->lock);
+    const int done = job->done;
+    pthread_mutex_unlock(&job->lock);
+    for (size_t i = 0; i < job->n; ++i) list->meta[i].size = __atomic_load_n(&job->totals[i], __ATOMIC_RELAXED);
+    if (done) {
+        ls->du_job = NULL;
+        _free_du(job);
+    }
+    if (list->sort == SORT_SIZE) _resort(ls);
 }
 
-struct tab *create_tab(char *path) {
-    if (lfm.num_tabs >= lfm.max_tabs)
-        lfm.tabs = realloc(lfm.tabs, (lfm.max_tabs *= 1.5)*sizeof(struct tab));
-    struct tab *tab = &lfm.tabs[lfm.num_tabs++];
-    tab->path = NULL;
-    tab->cur = tab->off = 0;
-    tab->show_hidden = opts.show_hidden;
-    _init_files(&tab->files);
-    list_files(tab, path);
-    return tab;
+// path made absolute against base (or the working directory) and rid of
+// . and .. without asking the file system. symlinks stay the way they
+// were followed, like a shell's cd does.
+static void _clean_path(const char *base, const char *path, char *out) {
+    char cwd[PATH_MAX];
+    size_t sz = 0;
+    if (path[0] != '/') {
+        if (!base) base = getcwd(cwd, sizeof(cwd))? cwd : "/";
+        _clean_path(NULL, base, out);
+        if ((sz = strlen(out)) == 1) sz = 0;
+    }
+    while (*path) {
+        while (*path == '/') ++path;
+        const char *end = strchrnul(path, '/');
+        const size_t n = end-path;
+        if (n == 2 && path[0] == '.' && path[1] == '.') {
+            while (sz && out[--sz] != '/');
+        } else if (n && !(n == 1 && path[0] == '.') && sz+1+n < PATH_MAX) {
+            out[sz++] = '/';
+            memcpy(out+sz, path, n);
+            sz += n;
+        }
+        path = end;
+    }
+    if (!sz) out[sz++] = '/';
+    out[sz] = 0;
 }
 
-void close_tab(struct tab *tab) {
-    if (--lfm.num_tabs == 0) quit_lfm(tab->path);
-    if (tab->path) free(tab->path);
-    if (tab->files.cap) _free_files(&tab->files);
-    lfm.mode = MODE_NONE;
-    for (struct tab *t = tab; t != &lfm.tabs[lfm.num_tabs]; ++t) *t = *(t+1);
-    if (lfm.cur_tab == &lfm.tabs[lfm.num_tabs]) --lfm.cur_tab;
-    chdir(lfm.cur_tab->path);
+static void _set_path(struct tab *tab, const char *path) {
+    char clean[PATH_MAX];
+    _clean_path(tab->path, path, clean);
+    free(tab->path);
+    tab->path = strdup(clean);
 }
 
-static void _switch_tab(void) {
-    if (lfm.num_tabs > 1) {
-        if (++lfm.cur_tab == &lfm.tabs[lfm.num_tabs])
-            lfm.cur_tab = &lfm.tabs[0];
-        reload_files(lfm.cur_tab);
-    }
+// puts the cursor back where the listing was left, as long as nothing
+// changed since and it's on want if there's one
+static int _restore_cursor(struct tab *tab, const char *want) {
+    struct listing *ls = tab->ls;
+    if (tab->files != &ls->files || ls->last_gen != ls->gen || ls->last_cur >= (int)ls->files.sz) return 0;
+    if (ls->files.order[ls->last_cur] != ls->last_mark) return 0;
+    if (want && strcmp(FILE_NAME(&ls->files, ls->last_cur), want)) return 0;
+    tab->cur = ls->last_cur, tab->off = ls->last_off;
+    _clamp_view(tab);
+    return 1;
 }
 
-void init_lfm(char *path) {
-    lfm.mode = MODE_NONE;
-    lfm.tabs = malloc((lfm.max_tabs = ALLOC_SIZE) * sizeof(struct tab));
-    lfm.num_tabs = 0;
-    _init_files(&lfm.selection);
-    lfm.cur_tab = create_tab(path);
-    input_reset(&lfm.input);
-    picker_reset(&lfm.picker);
+static void _show_listing(struct tab *tab, struct listing *ls, char *want, int want_row) {
+    _set_listing(tab, ls);
+    tab->cur = tab->off = 0;
+    if (tab->want) free(tab->want);
+    tab->want = NULL;
+    if (_restore_cursor(tab, want)) return;
+    tab->want = want? strdup(want) : NULL;
+    tab->want_row = want_row;
+    _resolve_want(tab);
 }
 
-void quit_lfm(char *path) {
-    FILE *file = fopen("/tmp/lfmsel", "w");
-    fwrite(path, strlen(path), 1, file);
-    fclose(file);
-    _quit_curses();
-    exit(0);
+// the listing of the directory at path, from the cache if it's still
+// good or read anew in the background
+static struct listing *_get_listing(const char *path, int show_hidden, int sort, int du) {
+    struct listing *ls = _lookup(path, show_hidden, sort, du, FALSE);
+    if (!ls) ls = _derive(path, show_hidden, sort, du);
+    if (!ls) {
+        ls = _new_listing(path, show_hidden, sort, du);
+        _start_load(ls, FALSE);
+    }
+    return ls;
 }
 
-static struct file _stat_file(struct tab *tab, char *name) {
-    char path[PATH_MAX] = {0};
-    sprintf(path, "%s/%s", tab->path, name);
-    struct stat file_stat;
-    lstat(path, &file_stat);
-    struct file file = {
-        .is_link = S_ISLNK(file_stat.st_mode),
-        .name = {0},
-        .path = {0},
-    };
-    stat(path, &file_stat); // XXX: stat'ing it twice is shit but nobody'll use ts so no biggie
-    file.type = S_ISDIR(file_stat.st_mode)? T_DIR : (file_stat.st_mode & S_IXUSR)? T_EXEC : T_FILE;
-    memcpy(file.name, name, strlen(name));
-    memcpy(file.path, tab->path, strlen(tab->path));
-    return file;
+// switches tab to path, taking the listing from the cache if it's still
+// good, and puts the cursor on want once it shows up.
+static void _open_listing(struct tab *tab, char *path, char *want, int want_row) {
+    _set_path(tab, path);
+    _show_listing(tab, _get_listing(tab->path, tab->show_hidden, tab->sort, tab->du), want, want_row);
 }
 
-static int _compare_files(const void *a_ptr, const void *b_ptr) {
-    const struct file *a = (struct file*)a_ptr, *b = (struct file*)b_ptr;
-    if (a->type == T_DIR && b->type != T_DIR) return -1;
-    if (a->type != T_DIR && b->type == T_DIR) return 1;
-    else return (strcasecmp(a->name, b->name));
+// a column next to the tab's keeps the listing of path (or none) in slot,
+// it's read like the tab's if it's not cached
+// only takes what's cached unless load is set
+static void _hold_listing(struct listing **slot, struct tab *tab, const char *path, int load) {
+    struct listing *ls = NULL, *old = *slot;
+    char clean[PATH_MAX];
+    if (path) _clean_path(NULL, path, clean);
+    if (old && path && !strcmp(old->path, clean) && old->show_hidden == tab->show_hidden && old->sort == tab->sort
+            && !old->du && !old->stale) return;
+    if (!old && !path) return;
+    if (path) ls = load? _get_listing(clean, tab->show_hidden, tab->sort, FALSE)
+        : _lookup(clean, tab->show_hidden, tab->sort, FALSE, FALSE);
+    if (ls) _ref_listing(ls);
+    *slot = ls;
+    _unref_listing(old);
 }
 
 void list_files(struct tab *tab, char *path) {
-    if (tab->path) free(tab->path);
-    tab->path = realpath(path, NULL);
-    if (!tab->path) goto fail;
-    chdir(tab->path);
-    tab->files.sz = tab->cur = tab->off = 0;
-    // XXX: i could probably use scandir with alphasort also
-    struct dirent *ent = NULL;
-    DIR *dir = opendir(path);
-    if (!dir) goto fail;
-    while ((ent = readdir(dir)) != NULL) {
-        if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
-        if (!tab->show_hidden && ent->d_name[0] == '.') continue;
-        struct file file = _stat_file(tab, ent->d_name);
-        _append_file(&tab->files, file);
-    }
-
-    qsort(tab->files.buf, tab->files.sz, sizeof(struct file), &_compare_files);
-    closedir(dir);
-    return;
-fail:
-    // XXX: maybe try displaying error on statusbar and chdir
-    //      to home directory before giving up and exitting.
-    fprintf(stderr, "error: path '%s' does not exist\n", path);
-    exit(1);
-}
-
-void select_file(struct file file) {
-    int idx = _find_file(&lfm.selection, file);
-    if (idx != -1) _remove_file(&lfm.selection, idx);
-    else _append_file(&lfm.selection, file);
+    _free_filter(tab);
+    _open_listing(tab, path, NULL, 0);
+    jump_visit(&lfm.jump, tab->path);
 }
 
-void select_all_files(struct tab *tab, bool add_all) {
-    for (int i = 0; i < tab->files.sz; ++i) {
-        if (_find_file(&lfm.selection, tab->files.buf[i]) == -1 || !add_all) {
-            select_file(tab->files.buf[i]);
-        }
-    }
+// shows everything under the tab's directory whose name contains pattern,
+// the listing fills up while the tree is walked
+static void _search(struct tab *tab, const char *pattern, char *want, int want_row) {
+    struct listing *ls = _new_listing(tab->path, tab->show_hidden, tab->sort, FALSE);
+    ls->find = strdup(pattern);
+    _start_find(ls);
+    _free_filter(tab);
+    _show_listing(tab, ls, want, want_row);
 }
 
-void reload_files(struct tab *tab) {
-    char path[PATH_MAX] = {0};
-    int cur = tab->cur, off = tab->off;
-    sprintf(path, "%s", tab->path);
-    list_files(tab, path);
-    if (!tab->files.sz) {
-        tab->cur = tab->off = 0;
-        return;
+// selected files are kept by their full path
+static inline void _file_path(struct tab *tab, int idx, char *path) {
+    snprintf(path, PATH_MAX, "%s/%s", tab->path, FILE_NAME(tab->files, idx));
+}
+
+// entries carry a selected bit so rendering never looks at the set. a
+// listing whose bits predate the last change of the selection gets them
+// recomputed before it's shown.
+static void _sync_selection(struct listing *ls) {
+    char path[PATH_MAX];
+    if (ls->sel_gen == lfm.sel_gen) return;
+    for (size_t i = 0; i < ls->files.sz; ++i) {
+        if (lfm.selection.sz) snprintf(path, sizeof(path), "%s/%s", ls->path, FILE_NAME(&ls->files, i));
+        FILE_AT(&ls->files, i).selected = lfm.selection.sz && strset_has(&lfm.selection, path);
     }
-    tab->cur = cur; tab->off = off;
-    while (tab->cur >= 0 && tab->cur >= tab->files.sz) move_up(tab);
+    ls->sel_gen = lfm.sel_gen;
+}
+
+static void _clear_selection(void) {
+    strset_clear(&lfm.selection);
+    ++lfm.sel_gen;
 }
 
-void scroll_up(struct tab *tab) {
-    if (tab->cur-tab->off < 0 && tab->off > 0) --tab->off;
+static void _select(struct tab *tab, int idx, int add) {
+    char path[PATH_MAX];
+    _file_path(tab, idx, path);
+    if (add) strset_add(&lfm.selection, path);
+    else strset_del(&lfm.selection, path);
+    FILE_AT(tab->files, idx).selected = add;
 }
 
-void scroll_down(struct tab *tab) {
-    if (tab->cur-tab->off > lfm.wh-2) ++tab->off;
+// the listing changed stays in sync, every other one is redone when shown
+static inline void _selection_changed(struct listing *ls) {
+    ls->sel_gen = ++lfm.sel_gen;
+}
+
+void select_file(struct tab *tab, int idx) {
+    _sync_selection(tab->ls);
+    _select(tab, idx, !FILE_AT(tab->files, idx).selected);
+    _selection_changed(tab->ls);
+}
+
+void select_all_files(struct tab *tab, bool add_all) {
+    _sync_selection(tab->ls);
+    for (int i = 0; i < tab->files->sz; ++i) {
+        const int selected = FILE_AT(tab->files, i).selected;
+        if (!selected || !add_all) _select(tab, i, !selected);
+    }
+    _selection_changed(tab->ls);
+}
+
+// keeps showing the current listing until the new one is complete, then
+// puts the cursors of every tab on it back on the same file.
+void reload_files(struct tab *tab) {
+    struct listing *ls = tab->ls;
+    if (ls->find) {
+        char *want = tab->files->sz? strdup(FILE_NAME(tab->files, tab->cur)) : NULL;
+        _search(tab, ls->find, want, tab->cur-tab->off);
+        return free(want);
+    }
+    for (struct tab *t = lfm.tabs; t != &lfm.tabs[lfm.num_tabs]; ++t) {
+        if (t->ls != ls || t->want) continue;
+        _sync_filter(t);
+        if (!t->files->sz) continue;
+        t->want = strdup(FILE_NAME(t->files, t->cur));
+        t->want_row = t->cur-t->off;
+    }
+    _clear_files(&ls->dirty);
+    if (ls->du) {
+        // sums are only trusted as long as the directories above changed
+        _cancel_du(ls);
+        _clear_du();
+    }
+    _start_load(ls, TRUE);
 }
 
 void move_left(struct tab *tab) {
-    char prev[PATH_MAX] = {0}, path[PATH_MAX] = {0}, found = 0;
+    char prev[PATH_MAX] = {0}, path[PATH_MAX] = {0};
     int sz = strlen(tab->path)-1;
+    if (tab->ls->find) {
+        // out of the search, onto where the entry is in the directory searched
+        if (tab->files->sz) sscanf(FILE_NAME(tab->files, tab->cur), "%[^/]", prev);
+        sprintf(path, "%s", tab->path);
+        _free_filter(tab);
+        return _open_listing(tab, path, prev[0]? prev : NULL, tab->cur-tab->off);
+    }
     for (; sz >= 0 && tab->path[sz] != '/'; --sz);
     memcpy(prev, tab->path+sz+1, strlen(tab->path)-sz);
     sprintf(path, "%s/..", tab->path);
-    list_files(tab, path);
-    for (int i = 0; i < tab->files.sz; ++i) {
-        if (!strcmp(tab->files.buf[i].name, prev)) {
-            found = 1;
-            break;
-        }
-        move_down(tab);
-    }
-    if (!found) tab->off = tab->cur = 0;
+    _free_filter(tab);
+    _open_listing(tab, path, prev, lfm.wh-2);
 }
 
 void move_right(struct tab *tab) {
-    if (!tab->files.sz) return;
-    struct file file = tab->files.buf[tab->cur];
-    if (file.type != T_DIR) return;
+    if (!tab->files->sz) return;
+    struct files_list *files = tab->files;
+    uint32_t idx = files->order[tab->cur];
+    // it may be a link to a directory the worker didn't get to yet, the
+    // entry is looked up by its index as sorting again may move it
+    if (files->buf[idx].pending) _stat_pending(tab->ls, &idx, 1);
+    if (files->buf[idx].type != T_DIR) return;
     char path[PATH_MAX] = {0};
-    sprintf(path, "%s/%s", tab->path, file.name);
+    snprintf(path, sizeof(path), "%s/%s", tab->path, files->names+files->buf[idx].name);
     list_files(tab, path);
 }
 
+// moves the cursor delta rows at once, the view follows just enough to show it
+void move_by(struct tab *tab, int delta) {
+    if (!tab->files->sz) return;
+    tab->cur = MAX(0, MIN((int)tab->files->sz-1, tab->cur+delta));
+    _clamp_view(tab);
+}
+
 void move_up(struct tab *tab) {
-    if (tab->cur == 0 || !tab->files.sz) return;
-    --tab->cur;
-    scroll_up(tab);
+    move_by(tab, -1);
 }
 
 void move_down(struct tab *tab) {
-    if (tab->cur >= tab->files.sz-1 || !tab->files.sz) return;
-    ++tab->cur;
-    scroll_down(tab);
+    move_by(tab, 1);
 }
 
 void move_home(struct tab *tab) {
@@ -264,45 +2377,105 @@ void move_home(struct tab *tab) {
 
 void move_end(struct tab *tab) {
     move_home(tab);
-    while (tab->cur < tab->files.sz-1) move_down(tab);
+    move_by(tab, tab->files->sz-1);
 }
 
 void page_up(struct tab *tab) {
-    for (int i = 0; i < lfm.wh-2; ++i) move_up(tab);
+    move_by(tab, -(lfm.wh-2));
 }
 
 void page_down(struct tab *tab) {
-    for (int i = 0; i < lfm.wh-2; ++i) move_down(tab);
+    move_by(tab, lfm.wh-2);
 }
 
 void toggle_hidden(struct tab *tab) {
-    char *file = strdup(tab->files.buf[tab->cur].name);
+    char path[PATH_MAX] = {0}, *want = tab->files->sz? strdup(FILE_NAME(tab->files, tab->cur)) : NULL;
+    const int row = tab->cur-tab->off;
+    sprintf(path, "%s", tab->path);
     tab->show_hidden = !tab->show_hidden;
-    reload_files(tab);
-    if (tab->files.sz && strcmp(tab->files.buf[tab->cur].name, file) != 0)
-        find_next(tab, file, strlen(file));
-    free(file);
+    if (tab->ls->find) _search(tab, tab->ls->find, want, row);
+    else _open_listing(tab, path, want, row);
+    free(want);
+}
+
+// sizes directories by everything below them, or back to their own size
+void toggle_du(struct tab *tab) {
+    char path[PATH_MAX] = {0}, *want = tab->files->sz? strdup(FILE_NAME(tab->files, tab->cur)) : NULL;
+    if (tab->ls->find) return free(want);
+    sprintf(path, "%s", tab->path);
+    tab->du = !tab->du;
+    _open_listing(tab, path, want, tab->cur-tab->off);
+    free(want);
+}
+
+// the listing in the next order is made out of the shown one if it's
+// complete, so the directory is only read again if it's not. searches
+// are walked again.
+void cycle_sort(struct tab *tab) {
+    char path[PATH_MAX] = {0}, *want = tab->files->sz? strdup(FILE_NAME(tab->files, tab->cur)) : NULL;
+    const int row = tab->cur-tab->off;
+    struct listing *ls = tab->ls;
+    tab->sort = (tab->sort+1) % NUM_SORTS;
+    if (SORT_META(tab->sort)) lfm.keep_meta = TRUE;
+    if (ls->find) {
+        _search(tab, ls->find, want, row);
+        return free(want);
+    }
+    if (!(ls = _lookup(tab->path, tab->show_hidden, tab->sort, tab->du, FALSE)))
+        ls = _derive(tab->path, tab->show_hidden, tab->sort, tab->du);
+    if (ls) _show_listing(tab, ls, want, row);
+    else {
+        sprintf(path, "%s", tab->path);
+        _open_listing(tab, path, want, row);
+    }
+    free(want);
 }
 
 // XXX: allow for searching only directories or files
 void find_next(struct tab *tab, char *str, int sz) {
-    if (!tab->files.sz) return;
+    if (!tab->files->sz) return;
     char to_find[PATH_MAX] = {0};
     memcpy(to_find, str, sz);
     int found = 0, where = 0;
-    for (where = tab->cur+1; where < tab->files.sz; ++where) {
-        if (strcasestr(tab->files.buf[where].name, to_find)) {
+    for (where = tab->cur+1; where < tab->files->sz; ++where) {
+        if (strcasestr(FILE_NAME(tab->files, where), to_find)) {
             found = 1; break;
         }
     }
     if (!found) {
         for (where = 0; where < tab->cur; ++where) {
-            if (strcasestr(tab->files.buf[where].name, to_find)) {
+            if (strcasestr(FILE_NAME(tab->files, where), to_find)) {
                 found = 1; break;
             }
         }
     }
-    if (found) for (tab->cur = tab->off = 0; tab->cur < where; move_down(tab));
+    if (found) {
+        move_home(tab);
+        move_by(tab, where);
+    }
+}
+
+// narrows the tab down to the entries containing str, or matching it
+// fuzzily ranked best first. only the sets past what str has in common
+// with the last pattern are made again.
+void filter_files(struct tab *tab, char *str, int sz, int fuzzy) {
+    struct filter *f = tab->filter;
+    if (!f) {
+        f = tab->filter = calloc(1, sizeof(struct filter));
+        f->ls = tab->ls, f->gen = tab->ls->gen;
+    }
+    _sync_filter(tab);
+    uint32_t mark = _cursor_mark(tab);
+    int k = 0, row = tab->cur-tab->off;
+    if (f->fuzzy != fuzzy) f->fuzzy = fuzzy, f->depth = 0;
+    // the best match is what a fuzzy search is after
+    if (fuzzy) tab->cur = tab->off = row = 0, mark = UINT32_MAX;
+    sz = MIN(sz, FILTER_MAX);
+    while (k < f->depth && k < sz && f->pattern[k] == str[k]) ++k;
+    memcpy(f->pattern, str, sz);
+    f->pattern[sz] = 0;
+    for (f->depth = k; f->depth < sz; ) _refine(f, ++f->depth);
+    _update_view(tab, mark, row);
 }
 
 void open_shell(struct tab *tab) {
@@ -310,49 +2483,241 @@ void open_shell(struct tab *tab) {
 }
 
 void edit_file(struct tab *tab) {
-    if (!tab->files.sz) return;
+    if (!tab->files->sz) return;
     char cmd[ALLOC_SIZE] = {0};
-    sprintf(cmd, "$EDITOR '%s'", tab->files.buf[tab->cur].name);
+    snprintf(cmd, sizeof(cmd), "$EDITOR '%s'", FILE_NAME(tab->files, tab->cur));
     execute(tab, cmd);
 }
 
+// commands run in the tab's directory, lfm only goes there for them
 void execute(struct tab *tab, char *cmd) {
     _quit_curses();
+    chdir(tab->path);
     system(cmd);
-    reload_files(tab);
+    _refresh(tab);
     _init_curses();
+    _invalidate_screen();
+}
+
+// formats row l into buf, returning its hash
+static void _human_size(size_t sz, char *buf) {
+    const char *units = "BKMGTP";
+    double val = sz;
+    for (; val >= 1024 && units[1]; val /= 1024) ++units;
+    if (*units == 'B') sprintf(buf, "%ld%c", sz, *units);
+    else sprintf(buf, "%.1f%c", val, *units);
+}
+
+// the screen is split in the parent's listing, the tab's and the preview,
+// with a gap between each. the tab's takes what the others leave.
+static inline int _parent_width(void) {
+    return lfm.columns? lfm.ww*PARENT_WIDTH/100 : 0;
+}
+
+static inline int _preview_width(void) {
+    return lfm.columns || lfm.show_preview? lfm.ww*PREVIEW_WIDTH/100 : 0;
+}
+
+static inline int _list_x(void) {
+    const int width = _parent_width();
+    return width? width+1 : 0;
+}
+
+static inline int _list_width(void) {
+    const int width = _preview_width();
+    return lfm.ww - _list_x() - (width? width+1 : 0);
 }
 
-static void _render_file(struct tab *tab, int l) {
-    struct file file = tab->files.buf[l];
-    char *prefix = (_find_file(&lfm.selection, file) != -1)? SELECTION_PREFIX : "";
+static uint64_t _format_file(struct files_list *files, int l, int cur, int width, int du, char *buf, int *attr) {
+    struct file file = FILE_AT(files, l);
+    char *name = FILE_NAME(files, l);
+    char *prefix = file.selected? SELECTION_PREFIX : "";
     char postfix[3] = {0};
-    int attr = 0, affix_size, size;
+    int affix_size, size;
 
     switch (file.type) {
-    case T_DIR:  attr = ATTR_DIR|COLOR_PAIR(PAIR_DIR);   strcat(postfix, "/"); break;
-    case T_EXEC: attr = ATTR_EXEC|COLOR_PAIR(PAIR_EXEC); strcat(postfix, "*"); break;
-    default:     attr = ATTR_FILE|COLOR_PAIR(PAIR_NORMAL); break;
+    case T_DIR:  *attr = ATTR_DIR|COLOR_PAIR(PAIR_DIR);   strcat(postfix, "/"); break;
+    case T_EXEC: *attr = ATTR_EXEC|COLOR_PAIR(PAIR_EXEC); strcat(postfix, "*"); break;
+    default:     *attr = ATTR_FILE|COLOR_PAIR(PAIR_NORMAL); break;
     }
-    if (file.is_link) { attr = ATTR_LINK|COLOR_PAIR(PAIR_LINK); strcat(postfix, "@"); }
-    if (tab->cur == l) attr |= A_REVERSE;
+    if (file.is_link) { *attr = ATTR_LINK|COLOR_PAIR(PAIR_LINK); strcat(postfix, "@"); }
+    if (cur == l) *attr |= A_REVERSE;
 
     affix_size = strlen(prefix) + strlen(postfix);
-    size = MIN(lfm.ww-affix_size, strlen(file.name));
-    attron(attr);
-    mvprintw(l-tab->off, 0, " %s%.*s%s", prefix, size, file.name, postfix);
-    attroff(attr);
+    if (du && files->meta) {
+        // sizes go on the right, names make room for them
+        char human[32];
+        _human_size(files->meta[files->order[l]].size, human);
+        affix_size += strlen(human)+2;
+        size = MAX(MIN(width-affix_size, file.name_sz), 0);
+        sprintf(buf, " %s%.*s%s%*s ", prefix, size, name, postfix, MAX(width-affix_size-size, 0)+(int)strlen(human), human);
+        return _hash_row(buf, *attr);
+    }
+    // the leading space counts too, a row one column too wide wraps onto the next
+    size = MAX(MIN(width-1-affix_size, file.name_sz), 0);
+    sprintf(buf, " %s%.*s%s", prefix, size, name, postfix);
+    return _hash_row(buf, *attr);
 }
 
+// only rows whose content changed are rewritten. when the same listing
+// just scrolled, the terminal scrolls what's there and only the rows
+// coming in are drawn.
 void render_files(struct tab *tab) {
-    if (tab->files.sz == 0) {
-        attron(A_REVERSE);
-        mvprintw(0, 0, "  empty  ");
-        attroff(A_REVERSE);
+    const int rows = lfm.wh-1, delta = tab->off-lfm.drawn_off;
+    char buf[PATH_MAX+16];
+    _sync_selection(tab->ls);
+    if (lfm.drawn_tab != tab || lfm.drawn_ls != tab->ls || lfm.drawn_rows != rows) _invalidate_screen();
+    else if (delta && abs(delta) < rows) {
+        scrollok(stdscr, TRUE);
+        scrl(delta);
+        scrollok(stdscr, FALSE);
+        lfm.drawn_preview = lfm.drawn_parent = 0; // they scrolled along
+        if (delta > 0) {
+            memmove(lfm.drawn, lfm.drawn+delta, (rows-delta)*sizeof(uint64_t));
+            memset(lfm.drawn+rows-delta, 0, delta*sizeof(uint64_t));
+        } else {
+            memmove(lfm.drawn-delta, lfm.drawn, (rows+delta)*sizeof(uint64_t));
+            memset(lfm.drawn, 0, -delta*sizeof(uint64_t));
+        }
+    } else if (delta) _invalidate_screen();
+    for (int r = 0; r < rows; ++r) {
+        const int i = tab->off+r;
+        int attr = 0;
+        uint64_t hash;
+        if (i < tab->files->sz) hash = _format_file(tab->files, i, tab->cur, _list_width(), tab->ls->du, buf, &attr);
+        else if (!i && !tab->ls->loader) {
+            attr = A_REVERSE;
+            hash = _hash_row(strcpy(buf, "  empty  "), attr);
+        } else hash = _hash_row(strcpy(buf, ""), attr);
+        if (hash == lfm.drawn[r]) continue;
+        move(r, _list_x());
+        if (lfm.columns || lfm.show_preview) printw("%*s", _list_width(), "");
+        else clrtoeol();
+        attron(attr);
+        mvprintw(r, _list_x(), "%s", buf);
+        attroff(attr);
+        lfm.drawn[r] = hash;
     }
-    for (int i = tab->off; i < tab->off+lfm.wh-1; ++i) {
-        if (i >= tab->files.sz) break;
-        _render_file(tab, i);
+    lfm.drawn_tab = tab, lfm.drawn_ls = tab->ls, lfm.drawn_off = tab->off;
+}
+
+// a listing in a column of its own from row 0, scrolled so cur is shown
+static void _render_column(struct listing *ls, int x, int width, int cur) {
+    const int rows = lfm.wh-1, off = MAX(MIN(cur-rows/2, (int)ls->files.sz-rows), 0);
+    char buf[PATH_MAX+16];
+    int attr;
+    _sync_selection(ls);
+    _want_rows(ls, &ls->files, off, off+rows);
+    for (int r = 0; r < rows && off+r < (int)ls->files.sz; ++r) {
+        _format_file(&ls->files, off+r, cur, width, FALSE, buf, &attr);
+        attron(attr);
+        mvprintw(r, x, "%.*s", width, buf);
+        attroff(attr);
+    }
+}
+
+static uint64_t _hash_column(struct listing *ls, int x, int cur) {
+    char key[80];
+    snprintf(key, sizeof(key), "%p %u %u %u %d %d %d", (void*)ls, ls? ls->gen : 0, ls? ls->stat_gen : 0, lfm.sel_gen, x, cur, lfm.wh);
+    return _hash_row(key, 0);
+}
+
+static void _clear_column(int x, int width) {
+    for (int r = 0; r < lfm.wh-1; ++r) mvprintw(r, x, "%*s", width, "");
+}
+
+// the listing of the tab's parent left of it, on the tab's directory
+static void _render_parent(struct tab *tab) {
+    char path[PATH_MAX];
+    const char *slash = strrchr(tab->path, '/');
+    const int width = _parent_width();
+    int cur = -1;
+    snprintf(path, sizeof(path), "%.*s", (int)(slash-tab->path), tab->path);
+    _hold_listing(&lfm.parent, tab, slash != tab->path || tab->path[1]? (path[0]? path : "/") : NULL, TRUE);
+    struct listing *ls = lfm.parent;
+    // the cursor left it on the tab's directory unless it changed since
+    if (ls && ls->last_gen == ls->gen && ls->last_cur < (int)ls->files.sz && ls->files.order[ls->last_cur] == ls->last_mark
+            && !strcmp(FILE_NAME(&ls->files, ls->last_cur), slash+1)) cur = ls->last_cur;
+    const uint64_t hash = _hash_column(ls, width, cur);
+    if (hash == lfm.drawn_parent) return;
+    lfm.drawn_parent = hash;
+    if (ls && cur < 0) cur = _search_file(&ls->files, slash+1);
+    _clear_column(0, width+1);
+    if (ls) _render_column(ls, 0, width, cur);
+}
+
+// the preview of the entry under the cursor right of the listing, or the
+// listing of the directory it's on. files are asked for whenever the
+// entry or its listing changes and drawn again once what's cached for
+// them does.
+static void _render_preview(struct tab *tab) {
+    static struct preview_entry e;
+    char path[PATH_MAX] = {0}, line[PATH_MAX];
+    const int x = _list_x()+_list_width()+1, width = lfm.ww-x, rows = lfm.wh-1;
+    const int is_dir = tab->files->sz && FILE_AT(tab->files, tab->cur).type == T_DIR;
+    if (tab->files->sz) _file_path(tab, tab->cur, path);
+    // scrolling over directories doesn't start loading each of them
+    lfm.settle_ms = 0;
+    if (!is_dir) lfm.child_path[0] = 0;
+    else if (strcmp(path, lfm.child_path)) {
+        strcpy(lfm.child_path, path);
+        clock_gettime(CLOCK_MONOTONIC, &lfm.child_since);
+    }
+    if (is_dir) lfm.settle_ms = MAX(CHILD_SETTLE_MS-_ms_since(&lfm.child_since), 0);
+    _hold_listing(&lfm.child, tab, is_dir? path : NULL, !lfm.settle_ms);
+    if (is_dir) {
+        struct listing *ls = lfm.child;
+        const int cur = ls && ls->last_gen == ls->gen? ls->last_cur : 0;
+        const uint64_t hash = _hash_column(ls, x, cur);
+        if (hash == lfm.drawn_preview) return;
+        lfm.drawn_preview = hash;
+        _clear_column(x-1, width+1);
+        if (ls) _render_column(ls, x, width, cur);
+        return;
+    }
+    if (strcmp(path, lfm.preview_path) || tab->ls->gen != lfm.preview_gen) {
+        if (path[0]) preview_want(&lfm.preview, path);
+        strcpy(lfm.preview_path, path);
+        lfm.preview_gen = tab->ls->gen;
+    }
+    const unsigned serial = path[0]? preview_get(&lfm.preview, path, NULL) : 0;
+    const uint64_t hash = _hash_row(path, serial);
+    if (hash == lfm.drawn_preview) return;
+    lfm.drawn_preview = hash;
+    _clear_column(x-1, width+1);
+    if (!serial || !preview_get(&lfm.preview, path, &e)) return;
+    switch (e.kind) {
+    case PREVIEW_BINARY:
+        _human_size(e.size, line);
+        mvprintw(0, x, "binary, %.*s", width-8, line);
+        return;
+    case PREVIEW_OTHER:
+        mvprintw(0, x, "%.*s", width, "special file");
+        return;
+    case PREVIEW_ERROR:
+        mvprintw(0, x, "%.*s", width, strerror(e.err));
+        return;
+    case PREVIEW_DIR:
+        return;
+    }
+    // tabs are expanded, other control characters can't be shown as they are
+    size_t i = 0;
+    for (int r = 0; r < rows && i < e.sz; ++r) {
+        int len = 0, col = 0;
+        for (; i < e.sz && e.buf[i] != '\n'; ++i) {
+            const unsigned char c = e.buf[i];
+            if (col >= width || len >= PATH_MAX-9) continue;
+            if (c == '\t') {
+                do line[len++] = ' '; while (++col % 8 && col < width);
+                continue;
+            }
+            line[len++] = (c < ' ' || c == 0x7f)? '?' : c;
+            // the rest of a utf-8 sequence doesn't take a column
+            if ((c & 0xc0) != 0x80) ++col;
+        }
+        ++i;
+        line[len] = 0;
+        mvprintw(r, x, "%s", line);
     }
 }
 
@@ -363,8 +2728,79 @@ static char *mode_to_cstr[] = {
     [MODE_MOVE] = "Move: ",
     [MODE_COPY] = "Copy: ",
     [MODE_DELETE] = "Delete: ",
+    [MODE_FILTER] = "Filter: ",
+    [MODE_FUZZY] = "Fuzzy: ",
+    [MODE_SEARCH] = "Search: ",
+};
+
+static const char *sort_names[NUM_SORTS] = {
+    [SORT_NAME] = "name",
+    [SORT_SIZE] = "size",
+    [SORT_MTIME] = "mtime",
+    [SORT_EXT] = "ext",
+    [SORT_NATURAL] = "natural",
 };
 
+static const char *op_names[NUM_OPS] = {
+    [OP_COPY] = "copy",
+    [OP_MOVE] = "mv",
+    [OP_DELETE] = "rm",
+};
+
+static const int op_threads[NUM_OPS] = {
+    [OP_COPY] = COPY_THREADS,
+    [OP_MOVE] = COPY_THREADS, // only when crossing filesystems
+    [OP_DELETE] = DELETE_THREADS,
+};
+
+static void _human_time(double secs, char *buf, size_t size) {
+    // a stalled copy can make this arbitrarily large (or nan)
+    if (!(secs < 99*3600)) { snprintf(buf, size, "--:--"); return; }
+    const unsigned s = MAX(secs, 0);
+    if (s >= 3600) snprintf(buf, size, "%u:%02u:%02u", s/3600, s/60%60, s%60);
+    else snprintf(buf, size, "%u:%02u", s/60, s%60);
+}
+
+// progress and eta once the size of everything is known
+// appends to buf, never past size, returning the new length
+static size_t _catf(char *buf, size_t size, size_t len, const char *fmt, ...) {
+    if (len >= size) return len;
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf+len, size-len, fmt, ap);
+    va_end(ap);
+    return n < 0? len : MIN(len+n, size-1);
+}
+
+static void _job_str(struct fileop *op, char *buf, size_t size) {
+    char done[16], total[16], rate[16], eta[16];
+    pthread_mutex_lock(&op->lock);
+    const double elapsed = fileop_elapsed(op), speed = op->bytes/MAX(elapsed, 0.001);
+    size_t len = _catf(buf, size, 0, "%s", op_names[op->kind]);
+    if (!op->started) len = _catf(buf, size, len, " queued");
+    else if (op->paused) len = _catf(buf, size, len, " paused");
+    if (op->started && op->kind == OP_COPY) {
+        _human_size(op->bytes, done);
+        _human_size(op->total, total);
+        _human_size(speed, rate);
+        if (op->scanning) len = _catf(buf, size, len, " %s %s/s", done, rate);
+        else {
+            _human_time(speed? (op->total-MIN(op->bytes, op->total))/speed : 0, eta, sizeof(eta));
+            len = _catf(buf, size, len, " %s/%s %d%% %s/s eta %s", done, total,
+                op->total? (int)(op->bytes*100/op->total) : 100, rate, eta);
+        }
+    } else if (op->started && op->kind == OP_MOVE) {
+        len = _catf(buf, size, len, " %ld/%ld", op->files, op->num_srcs);
+        _human_size(op->bytes, done);
+        // some of it is being copied over from another filesystem
+        if (op->bytes) len = _catf(buf, size, len, " %s", done);
+    } else if (op->started) {
+        len = _catf(buf, size, len, " %ld", op->files);
+    }
+    if (op->errors) _catf(buf, size, len, " %ld errors", op->errors);
+    pthread_mutex_unlock(&op->lock);
+}
+
 char *expand_home(const char *path) {
     char *res = calloc(1, PATH_MAX);
     if (!EXPAND_HOME) {
@@ -379,6 +2815,7 @@ char *expand_home(const char *path) {
     return res;
 }
 
+// the status only hits the screen when it changed, the input line always does
 void render_status(void) {
 #if _USE_COLOR
     const int attr = ATTR_STATUS|COLOR_PAIR(COLOR_STATUS);
@@ -387,16 +2824,45 @@ void render_status(void) {
 #endif
     struct tab *tab = lfm.cur_tab;
     char status[ALLOC_SIZE] = {0};
-    memset(status, ' ', lfm.ww);
+    if (strcmp(lfm.home_src, tab->path)) {
+        char *path = expand_home(tab->path);
+        snprintf(lfm.home_src, PATH_MAX, "%s", tab->path);
+        snprintf(lfm.home_path, PATH_MAX, "%s", path);
+        free(path);
+    }
+    size_t len = 0;
+    if (lfm.num_jobs) {
+        char job[ALLOC_SIZE];
+        _job_str(lfm.jobs[0], job, sizeof(job));
+        len = _catf(status, sizeof(status), len, " [%s]", job);
+        if (lfm.num_jobs > 1) len = _catf(status, sizeof(status), len, " +%d", lfm.num_jobs-1);
+    }
+    if (tab->sort != SORT_NAME) len = _catf(status, sizeof(status), len, " [%s]", sort_names[tab->sort]);
+    if (tab->filter && lfm.mode != MODE_FILTER && lfm.mode != MODE_FUZZY)
+        len = _catf(status, sizeof(status), len, " [%c%.32s]", tab->filter->fuzzy? '~' : '/', tab->filter->pattern);
+    if (tab->ls->find) len = _catf(status, sizeof(status), len, " [?%.32s]", tab->ls->find);
+    if (tab->ls->errors) len = _catf(status, sizeof(status), len, " %ld errors", tab->ls->errors);
+    if (tab->ls->du) len = _catf(status, sizeof(status), len, tab->ls->du_job? " [du...]" : " [du]");
+    if (tab->ls->loader) len = _catf(status, sizeof(status), len, " loading %ld...", tab->files->sz);
+    if (SHOW_SYSCALLS) len = _catf(status, sizeof(status), len, " [%ld syscalls]", tab->ls->syscalls);
+    _catf(status, sizeof(status), len, " %ld %d:%ld (%d:%d %s) ",
+        lfm.selection.sz, tab->cur+1, tab->files->sz,
+        (tab-lfm.tabs)+1, lfm.num_tabs, lfm.home_path);
+    const int status_sz = strlen(status);
+    if (lfm.mode == MODE_NONE) {
+        char line[ALLOC_SIZE*2];
+        snprintf(line, sizeof(line), "%s\n%s", lfm.msg, status);
+        if (!strcmp(line, lfm.drawn_status)) return;
+        strcpy(lfm.drawn_status, line);
+    } else lfm.drawn_status[0] = 0;
+    // as wide as the terminal, however wide that is
+    char blank[lfm.ww+1];
+    memset(blank, ' ', lfm.ww);
+    blank[lfm.ww] = 0;
     attron(attr);
-    mvprintw(lfm.wh-1, 0, "%s", status);
-    char *path = expand_home(tab->path);
-    sprintf(status, " %ld %d:%ld (%d:%d %s) ",
-        lfm.selection.sz, tab->cur+1, tab->files.sz,
-        (tab-lfm.tabs)+1, lfm.num_tabs, path);
-    free(path);
-    const size_t status_sz = strlen(status);
-    mvprintw(lfm.wh-1, lfm.ww-status_sz, "%s", status);
+    mvprintw(lfm.wh-1, 0, "%s", blank);
+    mvprintw(lfm.wh-1, MAX(0, lfm.ww-status_sz), "%s", status);
+    if (lfm.mode == MODE_NONE && lfm.msg[0]) mvprintw(lfm.wh-1, 0, "%.*s", MAX(0, lfm.ww-status_sz), lfm.msg);
     if (lfm.mode != MODE_NONE) {
         char *astr = mode_to_cstr[lfm.mode];
         mvprintw(lfm.wh-1, 0, "%s", astr);
@@ -412,6 +2878,12 @@ static inline void _mode_find(struct tab *tab, int ch) {
     if (lfm.input.text_sz) find_next(tab, lfm.input.text, lfm.input.text_sz);
 }
 
+static inline void _mode_search(struct tab *tab, int ch) {
+    char pattern[PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%.*s", lfm.input.text_sz, lfm.input.text);
+    _search(tab, pattern, NULL, 0);
+}
+
 static inline void _mode_exec(struct tab *tab, int ch) {
     char cmd[ALLOC_SIZE] = {0};
     sprintf(cmd, "%.*s", lfm.input.text_sz, lfm.input.text);
@@ -420,45 +2892,92 @@ static inline void _mode_exec(struct tab *tab, int ch) {
 
 static inline void _mode_open(struct tab *tab, int ch) {
     char cmd[ALLOC_SIZE] = {0};
-    sprintf(cmd, "%.*s '%s'",
-        lfm.input.text_sz, lfm.input.text, tab->files.buf[tab->cur].name);
+    snprintf(cmd, sizeof(cmd), "%.*s '%s'",
+        lfm.input.text_sz, lfm.input.text, FILE_NAME(tab->files, tab->cur));
     execute(tab, cmd);
 }
 
+// starts queued jobs in order while there are free slots, paused ones wait
+static void _schedule_jobs(void) {
+    int running = 0;
+    for (int i = 0; i < lfm.num_jobs; ++i) running += lfm.jobs[i]->started;
+    for (int i = 0; i < lfm.num_jobs && running < JOB_SLOTS; ++i) {
+        struct fileop *op = lfm.jobs[i];
+        if (op->started || op->paused) continue;
+        fileop_start(op);
+        ++running;
+    }
+}
+
+static void _queue_job(int kind, char **srcs, size_t num_srcs, const char *dst) {
+    lfm.jobs = realloc(lfm.jobs, (lfm.num_jobs+1)*sizeof(struct fileop*));
+    struct fileop *op = fileop_new(kind, srcs, num_srcs, dst, op_threads[kind], _wake_ui);
+    op->replace = MOVE_REPLACE;
+    lfm.jobs[lfm.num_jobs++] = op;
+    _schedule_jobs();
+}
+
+// finished jobs are dropped, inotify already brought their changes into
+// the listings but unwatched ones get reloaded
+static void _reap_jobs(void) {
+    int reaped = 0;
+    for (int i = 0; i < lfm.num_jobs; ) {
+        struct fileop *op = lfm.jobs[i];
+        if (op->started? !fileop_done(op) : !op->cancel) {
+            ++i;
+            continue;
+        }
+        if (op->errors) snprintf(lfm.msg, sizeof(lfm.msg), " %s: %ld errors", op_names[op->kind], op->errors);
+        fileop_free(op);
+        memmove(lfm.jobs+i, lfm.jobs+i+1, (--lfm.num_jobs-i)*sizeof(struct fileop*));
+        ++reaped;
+    }
+    if (!reaped) return;
+    _schedule_jobs();
+    _refresh(lfm.cur_tab);
+}
+
+static inline void _input_path(struct tab *tab, char *path) {
+    if (lfm.input.text[0] == '/') snprintf(path, PATH_MAX, "%.*s", lfm.input.text_sz, lfm.input.text);
+    else snprintf(path, PATH_MAX, "%s/%.*s", tab->path, lfm.input.text_sz, lfm.input.text);
+}
+
 static inline void _mode_move(struct tab *tab, int ch) {
-    char cmd[ALLOC_SIZE] = {0};
-    sprintf(cmd, "%s '%s' '%.*s'", (lfm.mode == MODE_MOVE)? "mv -f" : "cp -rf",
-        tab->files.buf[tab->cur].name, lfm.input.text_sz, lfm.input.text);
-    execute(tab, cmd);
+    char src[PATH_MAX], dst[PATH_MAX], *srcs[] = { src };
+    _file_path(tab, tab->cur, src);
+    _input_path(tab, dst);
+    _queue_job(lfm.mode == MODE_COPY? OP_COPY : OP_MOVE, srcs, 1, dst);
 }
 
 static inline void _mode_delete(struct tab *tab, int ch) {
-    char cmd[ALLOC_SIZE] = {0};
-    sprintf(cmd, "rm -rf '%.*s'", lfm.input.text_sz, lfm.input.text);
-    execute(tab, cmd);
+    char path[PATH_MAX], *srcs[] = { path };
+    _input_path(tab, path);
+    _queue_job(OP_DELETE, srcs, 1, NULL);
 }
 
-static inline void _execute_on_selection(struct tab *tab, char *op, bool to_path) {
-    const int sz = lfm.selection.sz*PATH_MAX*2;
-    char *cmd = calloc(sz, sizeof(char));
-    sprintf(cmd, "%s", op);
-    for (int i = 0; i < lfm.selection.sz; ++i) {
-        struct file *file = &lfm.selection.buf[i];
-        sprintf(cmd, "%s '%s/%s'", cmd, file->path, file->name);
-    }
-    if (to_path) sprintf(cmd, "%s '%s'", cmd, tab->path);
-    execute(tab, cmd);
-    free(cmd);
+// the selected paths, pointing into the selection
+static char **_selected_paths(size_t *n) {
+    char **paths = malloc(lfm.selection.sz*sizeof(char*));
+    *n = 0;
+    for (size_t i = 0; i < lfm.selection.cap; ++i)
+        if (STRSET_LIVE(&lfm.selection, i)) paths[(*n)++] = STRSET_AT(&lfm.selection, i);
+    return paths;
 }
 
 static inline void _mode_move_selected(struct tab *tab) {
-    _execute_on_selection(tab, lfm.mode == MODE_COPY? "cp -rf" : "mv -f", TRUE);
-    lfm.selection.sz = 0;
+    size_t n;
+    char **srcs = _selected_paths(&n);
+    _queue_job(lfm.mode == MODE_COPY? OP_COPY : OP_MOVE, srcs, n, tab->path);
+    free(srcs);
+    _clear_selection();
 }
 
 static inline void _mode_delete_selected(struct tab *tab) {
-    _execute_on_selection(tab, "rm -rf", FALSE);
-    lfm.selection.sz = 0;
+    size_t n;
+    char **srcs = _selected_paths(&n);
+    _queue_job(OP_DELETE, srcs, n, NULL);
+    free(srcs);
+    _clear_selection();
 }
 
 static void (*sel_mode_funs[NUM_ACTIONS])(struct tab*) = {
@@ -469,6 +2988,7 @@ static void (*sel_mode_funs[NUM_ACTIONS])(struct tab*) = {
 
 static void (*mode_funs[NUM_ACTIONS])(struct tab*, int) = {
     [MODE_FIND] = _mode_find,
+    [MODE_SEARCH] = _mode_search,
     [MODE_EXEC] = _mode_exec,
     [MODE_OPEN] = _mode_open,
     [MODE_MOVE] = _mode_move,
@@ -484,20 +3004,38 @@ static inline void _update_mode(struct tab *tab, int ch) {
     if (lfm.selection.sz && sel_mode_funs[lfm.mode]) {
         if (ch == '\n' || ch == 'y' || ch == 'Y') {
             sel_mode_funs[lfm.mode](tab);
-            reload_files(tab);
+            _refresh(tab);
         }
         lfm.mode = MODE_NONE;
         return;
     } else if (ch == '\n') {
         mode_funs[lfm.mode](tab, ch);
-        reload_files(tab);
+        _refresh(tab);
+        lfm.mode = MODE_NONE;
+    }
+    input_update(&lfm.input, ch);
+}
+
+// the listing follows the input on every key, enter keeps the filter on
+static void _update_filter(struct tab *tab, int ch) {
+    switch (ch) {
+    case CTRL('c'): case CTRL('q'):
         lfm.mode = MODE_NONE;
+        return _drop_filter(tab);
+    case '\n':
+        lfm.mode = MODE_NONE;
+        if (!lfm.input.text_sz) _drop_filter(tab);
+        return;
+    case KEY_UP: case KEY_DOWN:
+        return move_by(tab, ch == KEY_UP? -1 : 1);
     }
     input_update(&lfm.input, ch);
+    filter_files(tab, lfm.input.text, lfm.input.text_sz, lfm.mode == MODE_FUZZY);
 }
 
 static inline void _get_term_size(void) {
     getmaxyx(stdscr, lfm.wh, lfm.ww);
+    setscrreg(0, lfm.wh-2);
     if (lfm.ww < MIN_TERM_WIDTH || lfm.wh < MIN_TERM_HEIGHT) {
         _quit_curses();
         fprintf(stderr, "error: %s requires minimal terminal size of %dx%d.\n",
@@ -507,21 +3045,51 @@ static inline void _get_term_size(void) {
 }
 
 static void _list_tabs(void) {
-    for (int i = 0; i < lfm.num_tabs; ++i)
-        lfm.picker.tabs[lfm.picker.num_tabs++] = strdup(lfm.tabs[i].path);
+    char buf[PATH_MAX+1];
+    lfm.picker.title = "TABS";
+    for (int i = 0; i < lfm.num_tabs; ++i) {
+        char *path = expand_home(lfm.tabs[i].path);
+        snprintf(buf, sizeof(buf), "%s/", path);
+        lfm.picker.items[lfm.picker.num_items++] = strdup(buf);
+        free(path);
+    }
     lfm.picker.cur = lfm.cur_tab - lfm.tabs;
+    picker_filter(&lfm.picker);
 }
 
-static void _update_picker(void) {
-    int ch = getch();
+// rebuilt every frame to show the progress, the cursor stays where it was
+static void _list_jobs(void) {
+    struct picker *fp = &lfm.picker;
+    char buf[ALLOC_SIZE], job[ALLOC_SIZE];
+    for (int i = 0; i < fp->num_items; ++i) free(fp->items[i]);
+    fp->title = "JOBS";
+    for (fp->num_items = 0; fp->num_items < MIN(lfm.num_jobs, PICKER_ITEMS_MAX); ++fp->num_items) {
+        struct fileop *op = lfm.jobs[fp->num_items];
+        const char *src = strrchr(op->srcs[0], '/');
+        _job_str(op, job, sizeof(job));
+        size_t len = _catf(buf, sizeof(buf), 0, "%s  %s", job, src? src+1 : op->srcs[0]);
+        if (op->num_srcs > 1) len = _catf(buf, sizeof(buf), len, " (+%ld)", op->num_srcs-1);
+        if (op->dst) _catf(buf, sizeof(buf), len, " -> %s", op->dst);
+        fp->items[fp->num_items] = strdup(buf);
+    }
+    picker_filter(fp);
+}
+
+static void _update_picker(int ch) {
     switch (ch) {
     case KEY_QUIT: case CTRL('c'): case CTRL('q'):
         lfm.mode = MODE_NONE;
         break;
     case '\n':
         if (!lfm.picker.is_searching) {
-            lfm.cur_tab = lfm.tabs + lfm.picker.cur, lfm.mode = MODE_NONE;
-            chdir(lfm.cur_tab->path);
+            struct tab *prev = lfm.cur_tab;
+            const int sel = picker_selected(&lfm.picker);
+            lfm.mode = MODE_NONE;
+            if (sel >= 0) lfm.cur_tab = lfm.tabs + sel;
+            if (prev != lfm.cur_tab) {
+                if (prev->ls != lfm.cur_tab->ls) _cancel_load(prev->ls);
+                _refresh(lfm.cur_tab);
+            }
             break;
         }
     default:
@@ -530,14 +3098,131 @@ static void _update_picker(void) {
     }
 }
 
-void update(struct tab *tab) {
-    int ch = getch();
+// the directories best matching the input, rebuilt on every key. the
+// last ones stay while another instance is writing the index.
+static void _list_jump(void) {
+    struct picker *fp = &lfm.picker;
+    char *items[PICKER_ITEMS_MAX];
+    const int n = jump_query(&lfm.jump, fp->input.text, fp->input.text_sz, items, PICKER_ITEMS_MAX);
+    fp->title = "JUMP";
+    if (n < 0) return;
+    for (int i = 0; i < fp->num_items; ++i) free(fp->items[i]);
+    memcpy(fp->items, items, n*sizeof(char*));
+    fp->num_items = n;
+    fp->cur = fp->off = 0;
+    picker_filter(fp);
+}
+
+// directories gone since they were visited are dropped from the index
+static void _jump_to(struct tab *tab, char *path) {
+    struct stat dir_stat;
+    const int gone = stat(path, &dir_stat);
+    if (gone || !S_ISDIR(dir_stat.st_mode)) {
+        snprintf(lfm.msg, sizeof(lfm.msg), " jump: %s: %s", path, gone? strerror(errno) : "not a directory");
+        return jump_forget(&lfm.jump, path);
+    }
+    list_files(tab, path);
+}
+
+static void _update_jump(int ch) {
+    struct picker *fp = &lfm.picker;
+    switch (ch) {
+    case CTRL('c'): case CTRL('q'):
+        lfm.mode = MODE_NONE;
+        return;
+    case '\n':
+        lfm.mode = MODE_NONE;
+        if (picker_selected(fp) >= 0) _jump_to(lfm.cur_tab, fp->items[picker_selected(fp)]);
+        return;
+    case KEY_UP: case KEY_DOWN:
+        return _picker_move(fp, ch == KEY_UP? -1 : 1);
+    }
+    input_update(&fp->input, ch);
+    _list_jump();
+}
+
+static void _update_jobs(int ch) {
+    const int sel = picker_selected(&lfm.picker);
+    struct fileop *op = sel >= 0 && sel < lfm.num_jobs? lfm.jobs[sel] : NULL;
+    if (lfm.picker.is_searching) return picker_update(&lfm.picker, ch);
+    switch (ch) {
+    case KEY_QUIT: case CTRL('c'): case CTRL('q'):
+        lfm.mode = MODE_NONE;
+        break;
+    case KEY_JOB_PAUSE:
+        if (op) fileop_pause(op, !op->paused);
+        _schedule_jobs();
+        break;
+    case KEY_JOB_CANCEL:
+        if (op) fileop_cancel(op);
+        _reap_jobs();
+        break;
+    default:
+        picker_update(&lfm.picker, ch);
+        break;
+    }
+}
+
+static void _key_pressed(struct tab *tab) {
+    if (tab->want) {
+        // the user moved on before the file showed up
+        free(tab->want);
+        tab->want = NULL;
+    }
+    lfm.msg[0] = 0;
+}
+
+// rows a navigation key moves the cursor by, 0 for anything else
+static int _nav_delta(int ch) {
+    switch (ch) {
+    case KEY_UP: case KEY_NAVUP:
+        return -1;
+    case KEY_DOWN: case KEY_NAVDOWN:
+        return 1;
+    case KEY_PPAGE:
+        return -(lfm.wh-2);
+    case KEY_NPAGE:
+        return lfm.wh-2;
+    default:
+        return 0;
+    }
+}
+
+// handles every key typed so far before the next frame, runs of
+// navigation keys add up to one move
+static int _drain_input(void) {
+    int ch, delta = 0, keys = 0;
+    while ((ch = getch()) != ERR) {
+        const int d = (lfm.mode == MODE_NONE)? _nav_delta(ch) : 0;
+        ++keys;
+        if (d) {
+            delta += d;
+            continue;
+        }
+        if (delta) {
+            _key_pressed(lfm.cur_tab);
+            move_by(lfm.cur_tab, delta);
+            delta = 0;
+        }
+        if (lfm.mode == MODE_PICKER) _update_picker(ch);
+        else if (lfm.mode == MODE_JOBS) _update_jobs(ch);
+        else if (lfm.mode == MODE_JUMP) _update_jump(ch);
+        else update(lfm.cur_tab, ch);
+    }
+    if (delta) {
+        _key_pressed(lfm.cur_tab);
+        move_by(lfm.cur_tab, delta);
+    }
+    return keys;
+}
+
+void update(struct tab *tab, int ch) {
+    _key_pressed(tab);
     if (ch == KEY_RESIZE) {
         _get_term_size();
-        while (tab->cur-tab->off < 0) move_down(tab);
-        while (tab->cur-tab->off >= lfm.wh-1) move_up(tab);
-        return;
+        return move_by(tab, 0);
     }
+    if (lfm.mode == MODE_FILTER || lfm.mode == MODE_FUZZY) return _update_filter(tab, ch);
     if (lfm.mode != MODE_NONE) return _update_mode(tab, ch);
     switch (ch) {
     case CTRL('q'): case KEY_QUIT:
@@ -548,6 +3233,18 @@ void update(struct tab *tab) {
     case KEY_MODE_FIND:
         lfm.mode = MODE_FIND;
         return input_reset(&lfm.input);
+    case KEY_MODE_FILTER:
+        lfm.mode = MODE_FILTER;
+        if (tab->filter && !tab->filter->fuzzy) return input_set(&lfm.input, tab->filter->pattern, strlen(tab->filter->pattern));
+        return input_reset(&lfm.input);
+    case KEY_MODE_FUZZY:
+        lfm.mode = MODE_FUZZY;
+        if (tab->filter && tab->filter->fuzzy) return input_set(&lfm.input, tab->filter->pattern, strlen(tab->filter->pattern));
+        return input_reset(&lfm.input);
+    case KEY_MODE_SEARCH:
+        lfm.mode = MODE_SEARCH;
+        if (tab->ls->find) return input_set(&lfm.input, tab->ls->find, strlen(tab->ls->find));
+        return input_reset(&lfm.input);
     case KEY_FIND_NEXT:
         if (lfm.input.text_sz) find_next(tab, lfm.input.text, lfm.input.text_sz);
         return;
@@ -555,28 +3252,40 @@ void update(struct tab *tab) {
         lfm.mode = MODE_EXEC;
         return input_reset(&lfm.input);
     case KEY_MODE_OPEN:
-        if (!tab->files.sz) break;
+        if (!tab->files->sz) break;
         lfm.mode = MODE_OPEN;
         return input_reset(&lfm.input);
     case KEY_MODE_MOVE:
-        if (!tab->files.sz && !lfm.selection.sz) break;
+        if (!tab->files->sz && !lfm.selection.sz) break;
         lfm.mode = MODE_MOVE;
         if (lfm.selection.sz) return input_set(&lfm.input, SELECTION_TEXT, strlen(SELECTION_TEXT));
-        return input_set(&lfm.input, tab->files.buf[tab->cur].name, strlen(tab->files.buf[tab->cur].name));
+        return input_set(&lfm.input, FILE_NAME(tab->files, tab->cur), FILE_AT(tab->files, tab->cur).name_sz);
     case KEY_MODE_COPY:
-        if (!tab->files.sz && !lfm.selection.sz) break;
+        if (!tab->files->sz && !lfm.selection.sz) break;
         lfm.mode = MODE_COPY;
         if (lfm.selection.sz) return input_set(&lfm.input, SELECTION_TEXT, strlen(SELECTION_TEXT));
-        return input_set(&lfm.input, tab->files.buf[tab->cur].name, strlen(tab->files.buf[tab->cur].name));
+        return input_set(&lfm.input, FILE_NAME(tab->files, tab->cur), FILE_AT(tab->files, tab->cur).name_sz);
     case KEY_MODE_DELETE:
-        if (!tab->files.sz && !lfm.selection.sz) break;
+        if (!tab->files->sz && !lfm.selection.sz) break;
         lfm.mode = MODE_DELETE;
         if (lfm.selection.sz) return input_set(&lfm.input, SELECTION_TEXT, strlen(SELECTION_TEXT));
-        return input_set(&lfm.input, tab->files.buf[tab->cur].name, strlen(tab->files.buf[tab->cur].name));
+        return input_set(&lfm.input, FILE_NAME(tab->files, tab->cur), FILE_AT(tab->files, tab->cur).name_sz);
     case KEY_MODE_TABS:
         lfm.mode = MODE_PICKER;
         picker_reset(&lfm.picker);
         return _list_tabs();
+    case KEY_CANCEL_JOBS:
+        for (int i = 0; i < lfm.num_jobs; ++i) fileop_cancel(lfm.jobs[i]);
+        return _reap_jobs();
+    case KEY_MODE_JOBS:
+        lfm.mode = MODE_JOBS;
+        picker_reset(&lfm.picker);
+        return _list_jobs();
+    case KEY_MODE_JUMP:
+        lfm.mode = MODE_JUMP;
+        picker_reset(&lfm.picker);
+        lfm.picker.is_searching = 1; // shows the input
+        return _list_jump();
     case KEY_LEFT: case KEY_NAVBACK:
         return move_left(tab);
     case KEY_RIGHT: case KEY_NAVNEXT:
@@ -595,6 +3304,18 @@ void update(struct tab *tab) {
         return page_down(tab);
     case KEY_SHOW_HIDDEN:
         return toggle_hidden(tab);
+    case KEY_CYCLE_SORT:
+        return cycle_sort(tab);
+    case KEY_DISK_USAGE:
+        return toggle_du(tab);
+    case KEY_PREVIEW:
+        lfm.show_preview = !lfm.show_preview;
+        _invalidate_screen();
+        break;
+    case KEY_COLUMNS:
+        lfm.columns = !lfm.columns;
+        _invalidate_screen();
+        break;
     case KEY_NEW_TAB:
         lfm.cur_tab = create_tab(lfm.cur_tab->path);
         break;
@@ -603,11 +3324,11 @@ void update(struct tab *tab) {
     case KEY_SHELL:
         return open_shell(tab);
     case KEY_EDIT_FILE:
-        if (!tab->files.sz) break;
+        if (!tab->files->sz) break;
         return edit_file(tab);
     case KEY_SELECT_FILE:
-        if (!tab->files.sz) break;
-        select_file(tab->files.buf[tab->cur]);
+        if (!tab->files->sz) break;
+        select_file(tab, tab->cur);
         move_down(tab);
         break;
     case KEY_SELECT_ALL:
@@ -615,12 +3336,28 @@ void update(struct tab *tab) {
     case KEY_SELECT_INVERT:
         return select_all_files(tab, FALSE);
     case KEY_SELECT_EMPTY:
-        lfm.selection.sz = 0;
+        _clear_selection();
         break;
     default: break;
     }
 }
 
+// sleeps until there is input or a background thread has news for the ui
+static void _wait_events(void) {
+    struct pollfd fds[3] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = lfm.wake[0], .events = POLLIN },
+        { .fd = lfm.inotify, .events = POLLIN },
+    };
+    char buf[64];
+    // running jobs need their progress redrawn every now and then
+    int timeout = lfm.num_jobs? JOB_REFRESH_MS : -1;
+    if (lfm.settle_ms && (timeout < 0 || lfm.settle_ms < timeout)) timeout = lfm.settle_ms;
+    lfm.settle_ms = 0;
+    if (poll(fds, 3, timeout) > 0 && fds[1].revents & POLLIN)
+        while (read(lfm.wake[0], buf, sizeof(buf)) > 0);
+}
+
 static inline void _usage(void) {
     fprintf(stderr, "usage: %s [-h|-x] [path]\n", lfm.prgname);
     fprintf(stderr, "    -h    show this help and exit\n");
@@ -632,6 +3369,7 @@ int main(int argc, char **argv) {
     lfm.prgname = argv[0];
     char *path = ".";
     opts.show_hidden = SHOW_HIDDEN;
+    opts.sort = SORT_ORDER;
     for (int i = 1; i < argc; ++i) {
         if (!strcmp(argv[i], "-h")) _usage();
         else if (!strcmp(argv[i], "-x")) opts.show_hidden = TRUE;
@@ -641,15 +3379,27 @@ int main(int argc, char **argv) {
     _init_curses();
     _get_term_size();
     for (;;) {
-        erase();
-        if (lfm.mode == MODE_PICKER) {
+        _read_events();
+        for (struct listing *ls = lfm.listings; ls; ls = ls->next)
+            if (ls->loader) _take_loaded(ls);
+            else if (ls->du_job) _take_sizes(ls);
+        for (struct listing *ls = lfm.listings; ls; ls = ls->next)
+            if (ls->lazy_job) _take_stats(ls);
+        if (lfm.num_jobs) _reap_jobs();
+        for (struct tab *tab = lfm.tabs; tab != &lfm.tabs[lfm.num_tabs]; ++tab) _sync_filter(tab);
+        if (lfm.mode == MODE_JOBS) _list_jobs();
+        if (lfm.mode == MODE_PICKER || lfm.mode == MODE_JOBS || lfm.mode == MODE_JUMP) {
+            erase();
             picker_render(&lfm.picker);
-            _update_picker();
+            _invalidate_screen();
         } else {
+            _want_view(lfm.cur_tab, LAZY_MARGIN);
             render_files(lfm.cur_tab);
+            if (lfm.columns) _render_parent(lfm.cur_tab);
+            if (lfm.columns || lfm.show_preview) _render_preview(lfm.cur_tab);
             render_status();
-            update(lfm.cur_tab);
         }
+        if (!_drain_input()) _wait_events();
     }
     quit_lfm(lfm.cur_tab->path);
     return 0;
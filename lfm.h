@@ -1,12 +1,30 @@
 #ifndef __LFM_H
 #define __LFM_H
 
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
 #ifndef _USE_COLOR
 #define _USE_COLOR 0
 #endif
 
 #define CTRL(c) ((c) & 0x1f)
 #define ALLOC_SIZE 512
+#define STAT_BATCH 64
+#define URING_ENTRIES 256
+#define LOAD_CHUNK 4096
+#define LOAD_DENTS (1 << 18) // getdents64 buffer of a loader
+#define LAZY_MARGIN 64 // rows above and below the screen asked for with it
+#define JOB_REFRESH_MS 250
+#define CHILD_SETTLE_MS 80 // cursor rests on a directory this long before its listing is loaded next to it
+#define SORT_PREFIX 7 // name bytes in a sort key
+#define SORT_CUTOFF 32 // runs the radix sort leaves to insertion sort
+#define FILTER_MAX 255 // longest filter, no name is longer
+#define FILTER_SPLIT (1 << 16) // entries a filter goes through before splitting it across threads
+#define FILTER_BATCH (1 << 13)
+#define WALK_DENTS (1 << 16) // getdents64 buffer of a walk worker
+#define WALK_FLUSH_MS 50 // longest a walk worker keeps what it found to itself
 
 #define MIN(a, b) ((a) < (b)? (a) : (b))
 #define MAX(a, b) ((a) > (b)? (a) : (b))
@@ -16,37 +34,110 @@
 
 #include "config.h"
 
-enum { MODE_NONE, MODE_FIND, MODE_EXEC, MODE_OPEN, MODE_MOVE, MODE_COPY, MODE_DELETE, MODE_PICKER, NUM_ACTIONS };
+enum { MODE_NONE, MODE_FIND, MODE_EXEC, MODE_OPEN, MODE_MOVE, MODE_COPY, MODE_DELETE, MODE_PICKER, MODE_JOBS, MODE_FILTER, MODE_FUZZY, MODE_SEARCH, MODE_JUMP, NUM_ACTIONS };
 enum { PAIR_NORMAL, PAIR_STATUS = 1, PAIR_DIR, PAIR_EXEC, PAIR_LINK };
 enum { T_DIR, T_FILE, T_EXEC };
+enum { SORT_NAME, SORT_SIZE, SORT_MTIME, SORT_EXT, SORT_NATURAL, NUM_SORTS };
+
+#define SORT_META(sort) ((sort) == SORT_SIZE || (sort) == SORT_MTIME)
 
+// entries only keep an offset into the names arena of their list, the
+// directory they live in is stored once by whoever owns the list.
 struct file {
-    char path[PATH_MAX], name[PATH_MAX];
-    char is_link, type;
+    uint32_t name;
+    uint16_t name_sz;
+    char type;
+    unsigned char is_link : 1, selected : 1, pending : 1; // pending: not stat'ed yet, see LAZY_STAT
+};
+
+// what the stat calls of a listing found out beyond the type, only kept
+// once some sort order needs it.
+struct file_meta {
+    int64_t size, mtime;
 };
 
+// entries never move once appended, sorting only reorders the index array
+// and removing an entry only drops it from there.
 struct files_list {
-    size_t sz, cap;
+    size_t sz, cap; // entries in order
+    uint32_t *order; // indices into buf, in display order
+    size_t buf_sz, buf_cap;
     struct file *buf;
+    size_t names_sz, names_cap;
+    char *names;
+    struct file_meta *meta; // parallel to buf, NULL unless asked for
+    uint64_t *masks; // characters in the names of buf[0, masks_sz), made when filtering
+    size_t masks_sz;
+    int sort; // the order entries are kept in
+};
+
+#define FILE_AT(list, i) ((list)->buf[(list)->order[(i)]])
+#define FILE_NAME(list, i) ((list)->names + FILE_AT(list, i).name)
+
+struct loader;
+struct du_job;
+struct lazy_job;
+
+// the contents of a directory, shared by every tab showing it and kept
+// around for a while after the last one moved on.
+struct listing {
+    char *path;
+    char *find; // pattern of a search of the tree under path, its entries are paths relative to it
+    struct files_list files, dirty; // dirty: names changed while loading
+    struct loader *loader; // set while the listing is still being read
+    struct du_job *du_job; // set while the sizes of its directories are summed up
+    struct lazy_job *lazy_job; // set while pending entries are stat'ed
+    struct listing *prev, *next;
+    size_t syscalls; // metadata syscalls issued by the last listing
+    size_t errors; // directories a search couldn't read
+    unsigned sel_gen; // lfm's sel_gen the selected bits belong to
+    unsigned gen; // bumped whenever entries come or go
+    unsigned stat_gen; // bumped whenever pending entries get stat'ed
+    int refs, show_hidden, sort, du; // du: directories are sized by what's below them
+    int du_again; // a directory came in that the sums don't cover
+    int lazy; // some entries may still be pending
+    int last_cur, last_off; // where the cursor was when a tab last left it
+    uint32_t last_mark; // the entry it was on
+    unsigned last_gen; // and the listing's gen then, it's only good as long as that stays
+    int wd, stale; // inotify watch keeping it up to date, listing was cut short
+};
+
+// the entries of a listing containing a pattern, or its characters in
+// order when fuzzy. the match set of every prefix of it is kept so typing
+// narrows down the last one and erasing goes back to an earlier one.
+// fuzzy sets are ranked best match first.
+struct filter {
+    struct files_list view; // the listing's entries, in the order of the last set
+    struct listing *ls; // the sets were made from ls at gen
+    unsigned gen;
+    int depth, fuzzy;
+    int32_t *scores; // of the last entries matched, -1 if they didn't
+    uint32_t *pos; // where the entries of the first set are in the listing, to rank ties by
+    size_t scores_cap, pos_cap;
+    char pattern[FILTER_MAX+1];
+    uint32_t *sets[FILTER_MAX+1];
+    size_t sizes[FILTER_MAX+1], caps[FILTER_MAX+1];
 };
 
 struct tab {
     char *path;
-    struct files_list files;
-    int cur, off, show_hidden;
+    struct listing *ls;
+    struct filter *filter; // NULL unless the tab is filtered
+    struct files_list *files; // &ls->files or &filter->view
+    char *want; // file to put the cursor on once it's loaded
+    int cur, off, show_hidden, sort, du, want_row, mark;
 };
 
 void init_lfm(char *path);
 void quit_lfm(char *path);
 
 void list_files(struct tab *tab, char *path);
-void select_file(struct file file);
+void select_file(struct tab *tab, int idx);
 void select_all_files(struct tab *tab, bool add_all);
 
-void scroll_up(struct tab *tab);
-void scroll_down(struct tab *tab);
 void move_left(struct tab *tab);
 void move_right(struct tab *tab);
+void move_by(struct tab *tab, int delta);
 void move_up(struct tab *tab);
 void move_down(struct tab *tab);
 void move_home(struct tab *tab);
@@ -54,16 +145,19 @@ void move_end(struct tab *tab);
 void page_up(struct tab *tab);
 void page_down(struct tab *tab);
 void toggle_hidden(struct tab *tab);
+void cycle_sort(struct tab *tab);
+void toggle_du(struct tab *tab);
 void open_shell(struct tab *tab);
 void edit_file(struct tab *tab);
 void reload_files(struct tab *tab);
 void execute(struct tab *tab, char *cmd);
 void find_next(struct tab *tab, char *str, int sz);
+void filter_files(struct tab *tab, char *str, int sz, int fuzzy);
 struct tab *create_tab(char *path);
 void close_tab(struct tab *tab);
 char *expand_home(const char *path);
 
-void update(struct tab *tab);
+void update(struct tab *tab, int ch);
 void render_files(struct tab *tab);
 void render_status(void);
 
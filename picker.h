@@ -5,57 +5,72 @@
 #include <stdlib.h>
 #include "lfm.h"
 #include "config.h"
+#include "inputbox.h"
+#include "fuzzy.h"
 
-#ifndef PICKER_TABS_MAX
-#define PICKER_TABS_MAX 1024
+#ifndef PICKER_ITEMS_MAX
+#define PICKER_ITEMS_MAX 1024
 #endif
 
+// the items are shown through shown, all of them in order or, once
+// filtered, only the ones matching the input fuzzily and best first like
+// the listing's filter does. cur and off are rows of it.
 struct picker {
-    char *tabs[PICKER_TABS_MAX];
-    int num_tabs, cur, off, ww, wh, is_searching;
+    char *items[PICKER_ITEMS_MAX];
+    int shown[PICKER_ITEMS_MAX];
+    const char *title;
+    int num_items, num_shown, cur, off, ww, wh, is_searching, filtered;
     struct inputbox input;
 };
 
 void picker_update(struct picker *fp, int ch);
 void picker_render(struct picker *fp);
 void picker_reset(struct picker *fp);
+// shows the items again after they changed, the cursor stays on its row
+void picker_filter(struct picker *fp);
+int picker_selected(struct picker *fp); // item under the cursor, -1 if none
 
 static void _picker_move(struct picker *fp, int dir) {
     fp->cur += dir;
+    if (fp->cur >= fp->num_shown) fp->cur = fp->num_shown-1;
     if (fp->cur < 0) fp->cur = 0;
-    if (fp->cur >= fp->num_tabs) fp->cur = fp->num_tabs-1;
     if (fp->cur < fp->off) --fp->off;
     if (fp->wh != 0 && fp->cur-fp->off >= fp->wh-1) ++fp->off;
 }
 
-static void _picker_find(struct picker *fp, char *name) {
-    int cur = fp->cur, off = fp->off, pos, found = 0;
-    for (pos = cur+1; pos < fp->num_tabs; ++pos)
-        if (strcasestr(fp->tabs[pos], name)) goto jmp;
-    for (pos = 0; pos < cur; ++pos)
-        if (strcasestr(fp->tabs[pos], name)) goto jmp;
-    fp->cur = cur, fp->off = off;
-    return;
-jmp:
-    for (fp->cur = fp->off = 0; fp->cur < pos; _picker_move(fp, 1)){}
+void picker_filter(struct picker *fp) {
+    struct fuzzy fz;
+    int scores[PICKER_ITEMS_MAX];
+    fp->num_shown = 0;
+    if (fp->filtered) fuzzy_init(&fz, fp->input.text, fp->input.text_sz);
+    for (int i = 0; i < fp->num_items; ++i) {
+        const int score = fp->filtered? fuzzy_match(&fz, fp->items[i], strlen(fp->items[i])) : 0;
+        if (score < 0) continue;
+        // ties keep their order
+        int j = fp->num_shown++;
+        for (; j > 0 && scores[j-1] < score; --j) scores[j] = scores[j-1], fp->shown[j] = fp->shown[j-1];
+        scores[j] = score, fp->shown[j] = i;
+    }
+    if (fp->cur >= fp->num_shown) fp->cur = fp->num_shown? fp->num_shown-1 : 0;
+    if (fp->off > fp->cur) fp->off = fp->cur;
 }
 
-static void _picker_find_next(struct picker *fp) {
-    if (!fp->input.text_sz) return;
-    char *name = strndup(fp->input.text, fp->input.text_sz);
-    _picker_find(fp, name);
-    free(name);
+int picker_selected(struct picker *fp) {
+    return fp->cur < fp->num_shown? fp->shown[fp->cur] : -1;
 }
 
+// narrows the items down while typing, the best match on top
 static void _picker_update_find(struct picker *fp, int ch) {
     if (ch == CTRL('q') || ch == CTRL('c')) {
+        input_reset(&fp->input);
+        fp->is_searching = fp->filtered = 0;
+    } else if (ch == CTRL('f') || ch == '\n') {
         fp->is_searching = 0;
+        fp->filtered = fp->input.text_sz > 0;
         return;
-    }
-    if ((ch == CTRL('f') || ch == '\n') && fp->input.text_sz) {
-        _picker_find_next(fp);
-        fp->is_searching = 0;
     } else input_update(&fp->input, ch);
+    fp->cur = fp->off = 0;
+    picker_filter(fp);
 }
 
 void picker_update(struct picker *fp, int ch) {
@@ -77,14 +92,17 @@ void picker_update(struct picker *fp, int ch) {
         fp->cur = fp->off = 0;
         break;
     case KEY_END:
-        for (fp->cur = fp->off = 0; fp->cur+1 < fp->num_tabs; ) _picker_move(fp, 1);
+        for (fp->cur = fp->off = 0; fp->cur+1 < fp->num_shown; ) _picker_move(fp, 1);
         break;
     case CTRL('f'):
         input_reset(&fp->input);
-        fp->is_searching = 1;
+        fp->is_searching = fp->filtered = 1;
         break;
+    // the next match down, back to the best one past the last
     case CTRL('n'): case 'n':
-        if (fp->input.text_sz) _picker_find_next(fp);
+        if (!fp->filtered) break;
+        if (fp->cur+1 < fp->num_shown) _picker_move(fp, 1);
+        else fp->cur = fp->off = 0;
         break;
     }
 }
@@ -92,12 +110,10 @@ void picker_update(struct picker *fp, int ch) {
 void picker_render(struct picker *fp) {
     getmaxyx(stdscr, fp->wh, fp->ww);
     for (int i = fp->off; i < fp->off+fp->wh; ++i) {
-        if (i >= fp->num_tabs) break;
+        if (i >= fp->num_shown) break;
         const int attr = i == fp->cur? A_REVERSE : 0;
         attron(attr);
-        char *name = expand_home(fp->tabs[i]);
-        mvprintw(i-fp->off, 0, "%.*s/", fp->ww, name);
-        free(name);
+        mvprintw(i-fp->off, 0, "%.*s", fp->ww, fp->items[fp->shown[i]]);
         attroff(attr);
     }
 #if _USE_COLOR
@@ -105,12 +121,13 @@ void picker_render(struct picker *fp) {
 #else
     const int attr = ATTR_STATUS;
 #endif
-    char status[ALLOC_SIZE] = {0};
-    memset(status, ' ', fp->ww);
+    char status[ALLOC_SIZE], blank[fp->ww+1];
+    memset(blank, ' ', fp->ww);
+    blank[fp->ww] = 0;
     attron(attr);
-    mvprintw(fp->wh-1, 0, "%s", status);
-    sprintf(status, "%d:%d *TABS* ", fp->cur+1, fp->num_tabs);
-    mvprintw(fp->wh-1, fp->ww-strlen(status), "%s", status);
+    mvprintw(fp->wh-1, 0, "%s", blank);
+    snprintf(status, sizeof(status), "%d:%d *%s* ", fp->cur+1, fp->num_shown, fp->title);
+    mvprintw(fp->wh-1, MAX(0, fp->ww-(int)strlen(status)), "%s", status);
     if (fp->is_searching) {
         const char *str = "Find: ";
         const int cap = strlen(str)+strlen(status), inp_attr = attr & A_REVERSE? A_NORMAL : A_REVERSE;
@@ -122,11 +139,11 @@ void picker_render(struct picker *fp) {
 }
 
 void picker_reset(struct picker *fp) {
-    if (fp->num_tabs) {
-        for (int i = 0; i < fp->num_tabs; ++i)
-            free(fp->tabs[i]);
+    if (fp->num_items) {
+        for (int i = 0; i < fp->num_items; ++i)
+            free(fp->items[i]);
     }
-    fp->cur = fp->off = fp->num_tabs = fp->is_searching = 0;
+    fp->cur = fp->off = fp->num_items = fp->num_shown = fp->is_searching = fp->filtered = 0;
     input_reset(&fp->input);
 }
 
@@ -0,0 +1,91 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// fixed-size pool of worker threads splitting index ranges in batches.
+// the calling thread takes batches as well, so a pool of 0 threads just
+// runs everything serially.
+struct pool {
+    pthread_t *threads;
+    int num_threads, busy, quit;
+    pthread_mutex_t lock, run;
+    pthread_cond_t work, done;
+    void (*fn)(void *arg, size_t from, size_t to);
+    void *arg;
+    size_t next, end, batch;
+};
+
+void pool_init(struct pool *p, int num_threads);
+void pool_free(struct pool *p);
+void pool_for(struct pool *p, size_t n, size_t batch, void (*fn)(void*, size_t, size_t), void *arg);
+
+#ifdef POOL_IMPL
+
+#include <stdlib.h>
+
+// runs batches of the current job until there are none left, with the lock held
+static void _pool_drain(struct pool *p) {
+    while (p->next < p->end) {
+        const size_t from = p->next, to = (p->end-from > p->batch)? from+p->batch : p->end;
+        p->next = to;
+        ++p->busy;
+        pthread_mutex_unlock(&p->lock);
+        p->fn(p->arg, from, to);
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0 && p->next >= p->end) pthread_cond_broadcast(&p->done);
+    }
+}
+
+static void *_pool_worker(void *arg) {
+    struct pool *p = arg;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->quit && p->next >= p->end) pthread_cond_wait(&p->work, &p->lock);
+        if (p->quit) break;
+        _pool_drain(p);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+void pool_init(struct pool *p, int num_threads) {
+    p->busy = p->quit = 0;
+    p->next = p->end = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_mutex_init(&p->run, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->done, NULL);
+    p->threads = calloc(num_threads? num_threads : 1, sizeof(pthread_t));
+    for (p->num_threads = 0; p->num_threads < num_threads; ++p->num_threads)
+        if (pthread_create(&p->threads[p->num_threads], NULL, _pool_worker, p)) break;
+}
+
+void pool_free(struct pool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->num_threads; ++i) pthread_join(p->threads[i], NULL);
+    free(p->threads);
+    p->num_threads = 0;
+}
+
+void pool_for(struct pool *p, size_t n, size_t batch, void (*fn)(void*, size_t, size_t), void *arg) {
+    if (!n) return;
+    pthread_mutex_lock(&p->run);
+    pthread_mutex_lock(&p->lock);
+    p->fn = fn, p->arg = arg;
+    p->batch = batch? batch : 1;
+    p->next = 0, p->end = n;
+    if (n > p->batch) pthread_cond_broadcast(&p->work);
+    _pool_drain(p);
+    while (p->busy) pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+    pthread_mutex_unlock(&p->run);
+}
+
+#endif
+
+#endif
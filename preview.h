@@ -0,0 +1,198 @@
+#ifndef __PREVIEW_H
+#define __PREVIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+// the first bytes of files, read on a thread of its own so the ui never
+// waits on a big or slow file. the ui asks for a path and shows whatever
+// is cached for it, the thread checks it against the file and reads it
+// again if it changed. only the last path asked for is read, the ones
+// scrolled past are dropped. previews are kept per (device, inode, mtime).
+#ifndef PREVIEW_BYTES
+#define PREVIEW_BYTES (16 << 10) // read of a file at most
+#endif
+#ifndef PREVIEW_CACHE
+#define PREVIEW_CACHE 64 // previews kept
+#endif
+
+enum { PREVIEW_TEXT, PREVIEW_BINARY, PREVIEW_DIR, PREVIEW_OTHER, PREVIEW_ERROR };
+
+struct preview_entry {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    off_t size;
+    int kind, err;
+    unsigned serial; // changes whenever the entry does, 0 for an empty slot
+    uint64_t used;
+    size_t sz;
+    char buf[PREVIEW_BYTES];
+};
+
+struct preview {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    struct preview_entry *cache;
+    char *want; // the path to read next
+    unsigned serial;
+    uint64_t clock;
+    int running, quit;
+    void (*wake)(void); // called once a preview the ui may show is in
+};
+
+int preview_init(struct preview *pv, void (*wake)(void));
+void preview_free(struct preview *pv);
+void preview_want(struct preview *pv, const char *path);
+// copies what's cached for path into out, its serial or 0 if nothing is
+unsigned preview_get(struct preview *pv, const char *path, struct preview_entry *out);
+
+#ifdef PREVIEW_IMPL
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static struct preview_entry *_preview_find(struct preview *pv, const char *path) {
+    for (int i = 0; i < PREVIEW_CACHE; ++i)
+        if (pv->cache[i].serial && !strcmp(pv->cache[i].path, path)) return &pv->cache[i];
+    return NULL;
+}
+
+// the entry of the same file, or the least recently used one to take over
+static struct preview_entry *_preview_slot(struct preview *pv, const struct stat *st) {
+    struct preview_entry *lru = &pv->cache[0];
+    for (int i = 0; i < PREVIEW_CACHE; ++i) {
+        struct preview_entry *e = &pv->cache[i];
+        if (e->serial && e->dev == st->st_dev && e->ino == st->st_ino) return e;
+        if (e->used < lru->used) lru = e;
+    }
+    return lru;
+}
+
+// only regular files are opened, opening a device or a fifo may do
+// something. st is what the worker stat'ed, err its errno if it failed.
+// a nul byte in what was read makes it binary, like grep does.
+static void _preview_read(struct preview_entry *e, const char *path, const struct stat *st, int err) {
+    int fd = -1;
+    ssize_t n;
+    e->sz = 0, e->err = 0;
+    if (err) {
+        e->kind = PREVIEW_ERROR, e->err = err;
+    } else if (S_ISDIR(st->st_mode)) {
+        e->kind = PREVIEW_DIR;
+    } else if (!S_ISREG(st->st_mode)) {
+        e->kind = PREVIEW_OTHER;
+    } else if ((fd = open(path, O_RDONLY|O_NONBLOCK|O_NOCTTY|O_CLOEXEC)) < 0 || (n = pread(fd, e->buf, PREVIEW_BYTES, 0)) < 0) {
+        e->kind = PREVIEW_ERROR, e->err = errno;
+    } else {
+        e->sz = n;
+        e->kind = memchr(e->buf, 0, n)? PREVIEW_BINARY : PREVIEW_TEXT;
+    }
+    if (fd >= 0) close(fd);
+}
+
+static void *_preview_worker(void *arg) {
+    struct preview *pv = arg;
+    struct preview_entry *tmp = malloc(sizeof(struct preview_entry));
+    struct stat st;
+    pthread_mutex_lock(&pv->lock);
+    for (;;) {
+        while (!pv->want && !pv->quit) pthread_cond_wait(&pv->cond, &pv->lock);
+        if (pv->quit) break;
+        char *path = pv->want;
+        pv->want = NULL;
+        struct preview_entry *e = _preview_find(pv, path);
+        pthread_mutex_unlock(&pv->lock);
+        // still the same file as it was, nothing to read
+        const int ok = !stat(path, &st), err = ok? 0 : errno;
+        if (e && ok && e->dev == st.st_dev && e->ino == st.st_ino
+                && e->mtime.tv_sec == st.st_mtim.tv_sec && e->mtime.tv_nsec == st.st_mtim.tv_nsec && e->size == st.st_size) {
+            free(path);
+            pthread_mutex_lock(&pv->lock);
+            continue;
+        }
+        _preview_read(tmp, path, &st, err);
+        pthread_mutex_lock(&pv->lock);
+        if (!ok) memset(&st, 0, sizeof(st));
+        if (!(e = _preview_find(pv, path))) e = _preview_slot(pv, &st);
+        free(e->path);
+        e->path = path;
+        e->dev = st.st_dev, e->ino = st.st_ino, e->mtime = st.st_mtim, e->size = st.st_size;
+        e->kind = tmp->kind, e->err = tmp->err, e->sz = tmp->sz;
+        memcpy(e->buf, tmp->buf, tmp->sz);
+        if (!++pv->serial) ++pv->serial;
+        e->serial = pv->serial;
+        e->used = ++pv->clock;
+        pthread_mutex_unlock(&pv->lock);
+        pv->wake();
+        pthread_mutex_lock(&pv->lock);
+    }
+    pthread_mutex_unlock(&pv->lock);
+    free(tmp);
+    return NULL;
+}
+
+int preview_init(struct preview *pv, void (*wake)(void)) {
+    memset(pv, 0, sizeof(struct preview));
+    pv->wake = wake;
+    pv->cache = calloc(PREVIEW_CACHE, sizeof(struct preview_entry));
+    pthread_mutex_init(&pv->lock, NULL);
+    pthread_cond_init(&pv->cond, NULL);
+    if (pthread_create(&pv->thread, NULL, _preview_worker, pv)) return -1;
+    pv->running = 1;
+    return 0;
+}
+
+void preview_free(struct preview *pv) {
+    if (pv->running) {
+        pthread_mutex_lock(&pv->lock);
+        pv->quit = 1;
+        pthread_cond_signal(&pv->cond);
+        pthread_mutex_unlock(&pv->lock);
+        pthread_join(pv->thread, NULL);
+    }
+    for (int i = 0; i < PREVIEW_CACHE; ++i) free(pv->cache[i].path);
+    free(pv->cache);
+    free(pv->want);
+    pthread_mutex_destroy(&pv->lock);
+    pthread_cond_destroy(&pv->cond);
+}
+
+void preview_want(struct preview *pv, const char *path) {
+    if (!pv->running) return;
+    pthread_mutex_lock(&pv->lock);
+    free(pv->want);
+    pv->want = strdup(path);
+    pthread_cond_signal(&pv->cond);
+    pthread_mutex_unlock(&pv->lock);
+}
+
+unsigned preview_get(struct preview *pv, const char *path, struct preview_entry *out) {
+    unsigned serial = 0;
+    pthread_mutex_lock(&pv->lock);
+    struct preview_entry *e = _preview_find(pv, path);
+    if (e) {
+        e->used = ++pv->clock;
+        if (out) {
+            memcpy(out, e, offsetof(struct preview_entry, buf));
+            memcpy(out->buf, e->buf, e->sz);
+            out->path = NULL;
+        }
+        serial = e->serial;
+    }
+    pthread_mutex_unlock(&pv->lock);
+    return serial;
+}
+
+#endif
+
+#endif
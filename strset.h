@@ -0,0 +1,147 @@
+#ifndef __STRSET_H
+#define __STRSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// open addressing hash set of strings. the strings are interned in an
+// arena and slots hold their offset+1, so 0 is an empty slot.
+#define STRSET_DEAD UINT32_MAX
+
+struct strset {
+    char *names;
+    uint32_t *slots, *hashes;
+    size_t names_sz, names_cap, cap, sz, used; // used: live and dead slots
+    size_t dead_sz; // arena bytes of removed strings
+};
+
+#define STRSET_LIVE(set, i) ((set)->slots[(i)] && (set)->slots[(i)] != STRSET_DEAD)
+#define STRSET_AT(set, i) ((set)->names + (set)->slots[(i)] - 1)
+
+void strset_init(struct strset *set);
+void strset_free(struct strset *set);
+void strset_clear(struct strset *set);
+int strset_has(struct strset *set, const char *str);
+int strset_add(struct strset *set, const char *str); // 1 if it wasn't there
+int strset_del(struct strset *set, const char *str); // 1 if it was there
+
+#ifdef STRSET_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STRSET_MIN_CAP 64
+
+static inline uint32_t _strset_hash(const char *str) {
+    uint32_t hash = 2166136261u;
+    for (; *str; ++str) hash = (hash ^ (unsigned char)*str) * 16777619u;
+    return hash;
+}
+
+// slot holding str, or the slot it should go in if it's not there
+static size_t _strset_find(struct strset *set, const char *str, uint32_t hash, int *found) {
+    size_t i = hash & (set->cap-1), dead = set->cap;
+    for (;; i = (i+1) & (set->cap-1)) {
+        const uint32_t slot = set->slots[i];
+        if (!slot) break;
+        if (slot == STRSET_DEAD) {
+            if (dead == set->cap) dead = i;
+        } else if (set->hashes[i] == hash && !strcmp(set->names+slot-1, str)) {
+            *found = 1;
+            return i;
+        }
+    }
+    *found = 0;
+    return (dead != set->cap)? dead : i;
+}
+
+static uint32_t _strset_intern(struct strset *set, const char *str) {
+    const size_t sz = strlen(str)+1;
+    if (set->names_sz+sz > set->names_cap) {
+        while (set->names_sz+sz > set->names_cap) set->names_cap *= 2;
+        set->names = realloc(set->names, set->names_cap);
+    }
+    memcpy(set->names+set->names_sz, str, sz);
+    set->names_sz += sz;
+    return set->names_sz-sz+1;
+}
+
+// rebuilds the table and the arena without the removed strings
+static void _strset_grow(struct strset *set, size_t cap) {
+    struct strset old = *set;
+    set->cap = cap;
+    set->slots = calloc(cap, sizeof(uint32_t));
+    set->hashes = malloc(cap*sizeof(uint32_t));
+    set->names = malloc(set->names_cap = old.names_cap);
+    set->names_sz = set->sz = set->used = set->dead_sz = 0;
+    for (size_t i = 0; i < old.cap; ++i) {
+        if (!STRSET_LIVE(&old, i)) continue;
+        int found;
+        const size_t slot = _strset_find(set, STRSET_AT(&old, i), old.hashes[i], &found);
+        set->slots[slot] = _strset_intern(set, STRSET_AT(&old, i));
+        set->hashes[slot] = old.hashes[i];
+        ++set->sz, ++set->used;
+    }
+    free(old.slots);
+    free(old.hashes);
+    free(old.names);
+}
+
+void strset_init(struct strset *set) {
+    set->cap = STRSET_MIN_CAP;
+    set->slots = calloc(set->cap, sizeof(uint32_t));
+    set->hashes = malloc(set->cap*sizeof(uint32_t));
+    set->names = malloc(set->names_cap = STRSET_MIN_CAP*16);
+    set->names_sz = set->sz = set->used = set->dead_sz = 0;
+}
+
+void strset_free(struct strset *set) {
+    free(set->slots);
+    free(set->hashes);
+    free(set->names);
+    set->cap = set->sz = set->used = 0;
+}
+
+void strset_clear(struct strset *set) {
+    memset(set->slots, 0, set->cap*sizeof(uint32_t));
+    set->names_sz = set->sz = set->used = set->dead_sz = 0;
+}
+
+int strset_has(struct strset *set, const char *str) {
+    int found;
+    _strset_find(set, str, _strset_hash(str), &found);
+    return found;
+}
+
+int strset_add(struct strset *set, const char *str) {
+    const uint32_t hash = _strset_hash(str);
+    int found;
+    // removed strings are dropped along with their slots, or once they
+    // take up most of the arena
+    if ((set->used+1)*4 > set->cap*3)
+        _strset_grow(set, (set->sz+1)*2 > set->cap? set->cap*2 : set->cap);
+    else if (set->dead_sz > STRSET_MIN_CAP*16 && set->dead_sz*2 > set->names_sz)
+        _strset_grow(set, set->cap);
+    size_t slot = _strset_find(set, str, hash, &found);
+    if (found) return 0;
+    if (!set->slots[slot]) ++set->used;
+    set->slots[slot] = _strset_intern(set, str);
+    set->hashes[slot] = hash;
+    ++set->sz;
+    return 1;
+}
+
+// the string stays in the arena until the table is rebuilt
+int strset_del(struct strset *set, const char *str) {
+    int found;
+    const size_t slot = _strset_find(set, str, _strset_hash(str), &found);
+    if (!found) return 0;
+    set->dead_sz += strlen(STRSET_AT(set, slot))+1;
+    set->slots[slot] = STRSET_DEAD;
+    --set->sz;
+    return 1;
+}
+
+#endif
+
+#endif
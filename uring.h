@@ -0,0 +1,101 @@
+#ifndef __URING_H
+#define __URING_H
+
+#include <linux/io_uring.h>
+
+// minimal io_uring wrapper on top of the raw syscalls, just enough to
+// queue a batch of requests and reap their completions.
+struct uring {
+    int fd;
+    unsigned entries, *sq_head, *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_sz, cq_sz;
+};
+
+// returns -1 if io_uring is not available, ring is left unusable
+int uring_init(struct uring *r, unsigned entries);
+void uring_free(struct uring *r);
+struct io_uring_sqe *uring_get_sqe(struct uring *r);
+int uring_submit_and_wait(struct uring *r, unsigned wait_nr);
+struct io_uring_cqe *uring_peek_cqe(struct uring *r);
+void uring_cqe_seen(struct uring *r);
+
+#ifdef URING_IMPL
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+int uring_init(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+    r->sq_sz = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    r->cq_sz = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    r->sq_ptr = mmap(0, r->sq_sz, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->cq_ptr = mmap(0, r->cq_sz, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(0, p.sq_entries*sizeof(struct io_uring_sqe),
+        PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sq_ptr == MAP_FAILED || r->cq_ptr == MAP_FAILED || r->sqes == MAP_FAILED) {
+        if (r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_sz);
+        if (r->cq_ptr != MAP_FAILED) munmap(r->cq_ptr, r->cq_sz);
+        if (r->sqes != MAP_FAILED) munmap(r->sqes, p.sq_entries*sizeof(struct io_uring_sqe));
+        close(r->fd);
+        return r->fd = -1;
+    }
+    r->entries = p.sq_entries;
+    r->sq_head = (void*)((char*)r->sq_ptr + p.sq_off.head);
+    r->sq_tail = (void*)((char*)r->sq_ptr + p.sq_off.tail);
+    r->sq_mask = (void*)((char*)r->sq_ptr + p.sq_off.ring_mask);
+    r->sq_array = (void*)((char*)r->sq_ptr + p.sq_off.array);
+    r->cq_head = (void*)((char*)r->cq_ptr + p.cq_off.head);
+    r->cq_tail = (void*)((char*)r->cq_ptr + p.cq_off.tail);
+    r->cq_mask = (void*)((char*)r->cq_ptr + p.cq_off.ring_mask);
+    r->cqes = (void*)((char*)r->cq_ptr + p.cq_off.cqes);
+    return 0;
+}
+
+void uring_free(struct uring *r) {
+    if (r->fd < 0) return;
+    munmap(r->sqes, r->entries*sizeof(struct io_uring_sqe));
+    munmap(r->sq_ptr, r->sq_sz);
+    munmap(r->cq_ptr, r->cq_sz);
+    close(r->fd);
+    r->fd = -1;
+}
+
+// returns NULL when the submission queue is full. the tail is published
+// right away, that is fine as the kernel only looks at it on submit.
+struct io_uring_sqe *uring_get_sqe(struct uring *r) {
+    const unsigned tail = *r->sq_tail, head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (tail-head >= r->entries) return NULL;
+    const unsigned idx = tail & *r->sq_mask;
+    r->sq_array[idx] = idx;
+    memset(&r->sqes[idx], 0, sizeof(struct io_uring_sqe));
+    __atomic_store_n(r->sq_tail, tail+1, __ATOMIC_RELEASE);
+    return &r->sqes[idx];
+}
+
+int uring_submit_and_wait(struct uring *r, unsigned wait_nr) {
+    const unsigned pending = *r->sq_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    return syscall(__NR_io_uring_enter, r->fd, pending, wait_nr, wait_nr? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+struct io_uring_cqe *uring_peek_cqe(struct uring *r) {
+    const unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+void uring_cqe_seen(struct uring *r) {
+    __atomic_store_n(r->cq_head, *r->cq_head+1, __ATOMIC_RELEASE);
+}
+
+#endif
+
+#endif
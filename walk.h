@@ -0,0 +1,129 @@
+#ifndef __WALK_H
+#define __WALK_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// directories a few workers list in parallel, stealing from each other.
+// each worker has a deque of what it still has to list: the owner pushes
+// and pops at the end, thieves take from the start where the biggest
+// subtrees are. idle workers sleep until something is queued or everybody
+// is idle, then the walk is over.
+struct walk_deque {
+    pthread_mutex_t lock;
+    void **buf;
+    size_t head, tail, cap;
+};
+
+struct walk {
+    struct walk_deque *deques;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t queued, busy; // directories waiting over all deques, and being listed
+    int idle, num;
+};
+
+void walk_init(struct walk *wk, int num);
+void walk_free(struct walk *wk);
+void walk_push(struct walk *wk, int id, void *dir);
+// a directory for worker id, its own newest or someone else's oldest
+void *walk_take(struct walk *wk, int id);
+// a directory taken is dealt with
+void walk_done(struct walk *wk);
+// sleeps while there's nothing to take, 1 once the walk is over
+int walk_wait(struct walk *wk);
+// runs worker on this thread and on as many of the others as it can
+// start, each on its own slot of args
+void walk_run(struct walk *wk, void *(*worker)(void*), void *args, size_t arg_sz);
+
+#ifdef WALK_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+
+void walk_init(struct walk *wk, int num) {
+    wk->num = num > 1? num : 1;
+    wk->deques = calloc(wk->num, sizeof(struct walk_deque));
+    wk->queued = wk->busy = 0;
+    wk->idle = 0;
+    pthread_mutex_init(&wk->lock, NULL);
+    pthread_cond_init(&wk->cond, NULL);
+    for (int i = 0; i < wk->num; ++i) pthread_mutex_init(&wk->deques[i].lock, NULL);
+}
+
+void walk_free(struct walk *wk) {
+    for (int i = 0; i < wk->num; ++i) {
+        pthread_mutex_destroy(&wk->deques[i].lock);
+        free(wk->deques[i].buf);
+    }
+    free(wk->deques);
+    pthread_mutex_destroy(&wk->lock);
+    pthread_cond_destroy(&wk->cond);
+}
+
+void walk_push(struct walk *wk, int id, void *dir) {
+    struct walk_deque *q = &wk->deques[id];
+    pthread_mutex_lock(&q->lock);
+    if (q->tail >= q->cap) {
+        if (q->head) memmove(q->buf, q->buf+q->head, (q->tail-q->head)*sizeof(void*));
+        q->tail -= q->head, q->head = 0;
+        if (q->tail*2 >= q->cap) q->buf = realloc(q->buf, (q->cap = q->cap? q->cap*2 : 64)*sizeof(void*));
+    }
+    q->buf[q->tail++] = dir;
+    __atomic_add_fetch(&wk->queued, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&q->lock);
+    if (__atomic_load_n(&wk->idle, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&wk->lock);
+        pthread_cond_signal(&wk->cond);
+        pthread_mutex_unlock(&wk->lock);
+    }
+}
+
+void *walk_take(struct walk *wk, int id) {
+    void *dir = NULL;
+    for (int i = 0; i < wk->num && !dir; ++i) {
+        const int own = !i;
+        struct walk_deque *q = &wk->deques[(id+i) % wk->num];
+        pthread_mutex_lock(&q->lock);
+        if (q->head < q->tail) dir = own? q->buf[--q->tail] : q->buf[q->head++];
+        pthread_mutex_unlock(&q->lock);
+    }
+    // busy goes up first so the directory is always accounted for
+    if (dir) __atomic_add_fetch(&wk->busy, 1, __ATOMIC_SEQ_CST);
+    if (dir) __atomic_sub_fetch(&wk->queued, 1, __ATOMIC_SEQ_CST);
+    return dir;
+}
+
+// the last one listing wakes whoever waits, they may have to leave now
+void walk_done(struct walk *wk) {
+    if (__atomic_sub_fetch(&wk->busy, 1, __ATOMIC_SEQ_CST)) return;
+    pthread_mutex_lock(&wk->lock);
+    pthread_cond_broadcast(&wk->cond);
+    pthread_mutex_unlock(&wk->lock);
+}
+
+int walk_wait(struct walk *wk) {
+    pthread_mutex_lock(&wk->lock);
+    __atomic_add_fetch(&wk->idle, 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&wk->queued, __ATOMIC_SEQ_CST) && __atomic_load_n(&wk->busy, __ATOMIC_SEQ_CST))
+        pthread_cond_wait(&wk->cond, &wk->lock);
+    __atomic_sub_fetch(&wk->idle, 1, __ATOMIC_SEQ_CST);
+    const int quit = !__atomic_load_n(&wk->queued, __ATOMIC_SEQ_CST) && !__atomic_load_n(&wk->busy, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&wk->lock);
+    return quit;
+}
+
+// workers only leave once nothing is queued and nobody is listing, this
+// thread being one of them
+void walk_run(struct walk *wk, void *(*worker)(void*), void *args, size_t arg_sz) {
+    pthread_t threads[wk->num];
+    int started = 1;
+    for (; started < wk->num; ++started)
+        if (pthread_create(&threads[started], NULL, worker, (char*)args+started*arg_sz)) break;
+    worker(args);
+    for (int i = 1; i < started; ++i) pthread_join(threads[i], NULL);
+}
+
+#endif
+
+#endif